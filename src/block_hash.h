@@ -0,0 +1,91 @@
+/**
+ * @file block_hash.h
+ * @brief Open-addressing hash set of 64-bit cipher blocks for multi-target matching.
+ *
+ * A multi-target search computes one block per candidate key and has to tell whether it
+ * equals any of the target blocks. BlockHash answers that with one multiply and, almost
+ * always, a single probe: the table is at least twice the number of distinct blocks, uses
+ * linear probing and keeps the block values in their own array so a miss touches a single
+ * cache line. Targets sharing a block are chained, so every one of them is reported.
+ *
+ * @date October 2024
+ */
+
+#ifndef BLOCK_HASH_H
+#define BLOCK_HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Reads an 8-byte block as a 64-bit value (native byte order).
+ */
+static inline uint64_t loadBlock(const unsigned char* bytes) {
+    uint64_t block;
+    memcpy(&block, bytes, sizeof(block));
+    return block;
+}
+
+/**
+ * @brief Maps 64-bit blocks to the indices of the targets holding them.
+ */
+class BlockHash {
+public:
+    static const uint32_t kNone = UINT32_MAX;
+
+    /**
+     * @brief Builds the table; target `i` is identified by its index in `blocks`.
+     */
+    explicit BlockHash(const std::vector<uint64_t>& blocks) : chain(blocks.size(), kNone) {
+        size_t capacity = 16;
+        shift = 60;
+        while (capacity < 2 * blocks.size()) {
+            capacity <<= 1;
+            --shift;
+        }
+        mask = capacity - 1;
+        slots.assign(capacity, 0);
+        heads.assign(capacity, kNone);
+        for (uint32_t i = blocks.size(); i-- > 0;) {
+            size_t slot = locate(blocks[i]);
+            if (heads[slot] == kNone) {
+                slots[slot] = blocks[i];
+            }
+            chain[i] = heads[slot];
+            heads[slot] = i;
+        }
+    }
+
+    /**
+     * @brief Returns the first target holding `block`, or kNone.
+     */
+    inline uint32_t find(uint64_t block) const {
+        return heads[locate(block)];
+    }
+
+    /**
+     * @brief Returns the next target holding the same block as `index`, or kNone.
+     */
+    inline uint32_t next(uint32_t index) const {
+        return chain[index];
+    }
+
+private:
+    /// Slot holding `block`, or the empty slot where it would be inserted.
+    inline size_t locate(uint64_t block) const {
+        size_t slot = (block * 0x9E3779B97F4A7C15ULL) >> shift;
+        while (heads[slot] != kNone && slots[slot] != block) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    std::vector<uint64_t> slots;   ///< Block stored in each slot.
+    std::vector<uint32_t> heads;   ///< First target of each slot, or kNone when empty.
+    std::vector<uint32_t> chain;   ///< Next target with the same block.
+    uint64_t mask;
+    int shift;
+};
+
+#endif  // BLOCK_HASH_H
@@ -0,0 +1,235 @@
+/**
+ * @file candidates.h
+ * @brief Password candidate enumerators (masks, wordlists, charset spaces) addressable by index.
+ *
+ * The password crackers split their candidates over the ranks and threads the way the key
+ * searches split keys: by index. Every enumerator therefore maps an index in
+ * [0, count()) to its candidate directly, without walking the ones before it.
+ *
+ * - A mask is a string of positions, each either a literal character or a charset:
+ *   `?l` lowercase, `?u` uppercase, `?d` digits, `?s` symbols, `?a` all printable ASCII,
+ *   `??` a literal `?`. The last position varies fastest: `?u?l?l?d` gives Aaa0, Aaa1, ...
+ * - A wordlist is a file with one candidate per line (trailing `\r` removed). It is read
+ *   into memory with an index of line offsets.
+ * - A charset space is every string over a charset with a length in a range, shortest
+ *   first (the exhaustive search of short passwords).
+ *
+ * @date October 2024
+ */
+
+#ifndef CANDIDATES_H
+#define CANDIDATES_H
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A list of password candidates.
+ */
+class Candidates {
+public:
+    virtual ~Candidates() {}
+
+    /// Number of candidates.
+    virtual uint64_t count() const = 0;
+
+    /// Sets `out` to candidate `index` (< count()).
+    virtual void at(uint64_t index, std::string& out) const = 0;
+};
+
+/**
+ * @brief The candidates of a mask.
+ */
+class MaskCandidates : public Candidates {
+public:
+    /**
+     * @brief Parses the mask.
+     *
+     * @param error Set to a description of the problem on failure.
+     * @return true If the mask is valid and has fewer than 2^64 candidates.
+     */
+    bool parse(const std::string& mask, std::string& error) {
+        static const std::string lower = "abcdefghijklmnopqrstuvwxyz";
+        static const std::string upper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        static const std::string digits = "0123456789";
+        static const std::string symbols = " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+        positions.clear();
+        total = 1;
+        for (size_t i = 0; i < mask.size(); ++i) {
+            std::string set(1, mask[i]);
+            if (mask[i] == '?') {
+                char c = i + 1 < mask.size() ? mask[++i] : '\0';
+                switch (c) {
+                    case 'l': set = lower; break;
+                    case 'u': set = upper; break;
+                    case 'd': set = digits; break;
+                    case 's': set = symbols; break;
+                    case 'a': set = lower + upper + digits + symbols; break;
+                    case '?': set = "?"; break;
+                    default:
+                        error = "Unknown charset ?" + std::string(1, c) + " in mask " + mask;
+                        return false;
+                }
+            }
+            if (total > UINT64_MAX / set.size()) {
+                error = "Mask " + mask + " has too many candidates";
+                return false;
+            }
+            total *= set.size();
+            positions.push_back(set);
+        }
+        if (positions.empty()) {
+            error = "Empty mask";
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t count() const override { return total; }
+
+    void at(uint64_t index, std::string& out) const override {
+        out.resize(positions.size());
+        for (size_t i = positions.size(); i-- > 0;) {
+            out[i] = positions[i][index % positions[i].size()];
+            index /= positions[i].size();
+        }
+    }
+
+private:
+    std::vector<std::string> positions;  ///< Characters of every position.
+    uint64_t total = 0;
+};
+
+/**
+ * @brief The lines of a wordlist file.
+ */
+class WordlistCandidates : public Candidates {
+public:
+    /**
+     * @brief Reads the wordlist.
+     *
+     * @param error Set to a description of the problem on failure.
+     * @return true If the file was read.
+     */
+    bool load(const std::string& path, std::string& error) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            error = "Cannot read wordlist " + path;
+            return false;
+        }
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        starts.clear();
+        size_t at = 0;
+        while (at < text.size()) {
+            size_t end = text.find('\n', at);
+            if (end == std::string::npos) {
+                end = text.size();
+            }
+            starts.push_back(at);
+            at = end + 1;
+        }
+        starts.push_back(at);  // Sentinel: one past the last line's newline (or the end)
+        return true;
+    }
+
+    uint64_t count() const override { return starts.size() - 1; }
+
+    void at(uint64_t index, std::string& out) const override {
+        size_t begin = starts[index];
+        size_t end = starts[index + 1] - 1;
+        if (end > begin && text[end - 1] == '\r') {
+            --end;
+        }
+        out.assign(text, begin, end - begin);
+    }
+
+private:
+    std::string text;
+    std::vector<size_t> starts;  ///< Offset of every line, then a sentinel.
+};
+
+/**
+ * @brief Every string over a charset with a length in [minLength, maxLength], shortest first.
+ */
+class CharsetCandidates : public Candidates {
+public:
+    /**
+     * @brief Sets the space.
+     *
+     * @param error Set to a description of the problem on failure.
+     * @return true If the space is valid and has fewer than 2^64 candidates.
+     */
+    bool init(const std::string& chars, size_t minLength, size_t maxLength, std::string& error) {
+        charset = chars;
+        firstLength = minLength;
+        sizes.clear();
+        total = 0;
+        if (charset.empty() || minLength > maxLength) {
+            error = "Empty charset space";
+            return false;
+        }
+        uint64_t size = 1;
+        for (size_t length = 0; length <= maxLength; ++length) {
+            if (length >= minLength) {
+                if (total > UINT64_MAX - size) {
+                    error = "Charset space has too many candidates";
+                    return false;
+                }
+                total += size;
+                sizes.push_back(size);
+            }
+            if (length < maxLength && size > UINT64_MAX / charset.size()) {
+                error = "Charset space has too many candidates";
+                return false;
+            }
+            size *= charset.size();
+        }
+        return true;
+    }
+
+    uint64_t count() const override { return total; }
+
+    void at(uint64_t index, std::string& out) const override {
+        size_t length = firstLength;
+        for (size_t i = 0; index >= sizes[i]; ++i, ++length) {
+            index -= sizes[i];
+        }
+        out.resize(length);
+        for (size_t i = length; i-- > 0;) {
+            out[i] = charset[index % charset.size()];
+            index /= charset.size();
+        }
+    }
+
+private:
+    std::string charset;
+    size_t firstLength = 0;
+    std::vector<uint64_t> sizes;  ///< Candidates of every length, from the shortest.
+    uint64_t total = 0;
+};
+
+/**
+ * @brief Opens the candidates given by a mask or a wordlist (exactly one of them).
+ *
+ * @param error Set to a description of the problem on failure.
+ * @return The candidates, or nullptr on failure.
+ */
+static inline std::unique_ptr<Candidates> openCandidates(const std::string& mask, const std::string& wordlist,
+                                                         std::string& error) {
+    if (mask.empty() == wordlist.empty()) {
+        error = "Give either --mask or --wordlist";
+        return nullptr;
+    }
+    if (!mask.empty()) {
+        std::unique_ptr<MaskCandidates> candidates(new MaskCandidates());
+        return candidates->parse(mask, error) ? std::move(candidates) : nullptr;
+    }
+    std::unique_ptr<WordlistCandidates> candidates(new WordlistCandidates());
+    return candidates->load(wordlist, error) ? std::move(candidates) : nullptr;
+}
+
+#endif  // CANDIDATES_H
@@ -0,0 +1,288 @@
+/**
+ * @file cipher_policy.h
+ * @brief Cipher policies: the cipher operations the brute-force drivers are written against.
+ *
+ * The drivers' searches, schedulers and predicates are templates over a Cipher policy, a
+ * class of static members only. Every call is resolved at compile time and inlined into
+ * the hot loop, so supporting another cipher costs no indirection per key. A policy
+ * provides:
+ *
+ * - `Schedule`: the expanded key, built once per key and reused for every block. The
+ *   operations below never modify it.
+ * - `kKeyBytes`, `kBlockBytes`: sizes of a key and of a block (the unit of windows and cribs).
+ * - `kKeySpace`: number of keys; the drivers search the integers [0, kKeySpace).
+ * - `kStream`: true for a stream cipher, whose output depends on the position in the
+ *   message (the `offset` arguments); a block cipher in ECB mode ignores them.
+ * - `name()`: the name of the cipher, for reports.
+ * - `keyFromInteger(key, bytes)`: the key bytes of a key-space integer.
+ * - `setKey(bytes, schedule)`: expands a key.
+ * - `kBatch`, `setKeys(bytes, schedules, count)`: expands `count` <= kBatch consecutive keys
+ *   (`count` x kKeyBytes bytes) at once. The hot loops schedule kBatch keys per step, so a
+ *   cipher can interleave independent schedules; kBatch is 1 when that does not pay.
+ * - `decryptBlocks(schedule, in, out, len, offset)`: decrypts the window the predicate
+ *   checks, `offset` bytes into the message; the hot-path operation.
+ * - `encryptBlock(schedule, in, out, offset)`: encrypts one block, for the multi-target sweeps.
+ * - `encrypt(key, in, out, len, iv, offset)` / `decrypt(...)`: whole messages (or their part
+ *   from `offset`), in CBC mode when a block cipher is given an IV. Used to build jobs and
+ *   verify keys, off the hot path.
+ *
+ * @date October 2024
+ */
+
+#ifndef CIPHER_POLICY_H
+#define CIPHER_POLICY_H
+
+#include <openssl/des.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @brief Single DES (OpenSSL). Key-space integers are 64-bit keys whose parity bits are set
+ * before use, so consecutive integers name the same key in pairs.
+ */
+struct DesCipher {
+    typedef DES_key_schedule Schedule;
+    static const size_t kKeyBytes = 8;
+    static const size_t kBlockBytes = 8;
+    static const uint64_t kKeySpace = 1ULL << 56;
+    static const bool kStream = false;
+
+    static const size_t kBatch = 1;
+
+    static inline const char* name() { return "DES"; }
+
+    /**
+     * @brief Converts a key-space integer to an 8-byte key (big-endian).
+     */
+    static inline void keyFromInteger(uint64_t key, unsigned char* bytes) {
+        for (int i = 0; i < 8; ++i) {
+            bytes[7 - i] = (key >> (i * 8)) & 0xFF;
+        }
+    }
+
+    /**
+     * @brief Builds the key schedule, with odd parity set and weak keys accepted.
+     */
+    static inline void setKey(const unsigned char* key, Schedule& schedule) {
+        DES_cblock keyBlock;
+        memcpy(keyBlock, key, 8);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+        DES_set_odd_parity(&keyBlock);
+        DES_set_key_unchecked(&keyBlock, &schedule);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+    }
+
+    static inline void setKeys(const unsigned char* keys, Schedule* schedules, size_t count) {
+        for (size_t b = 0; b < count; ++b) {
+            setKey(keys + b * kKeyBytes, schedules[b]);
+        }
+    }
+
+    /**
+     * @brief Decrypts `len` bytes (a multiple of 8) block by block.
+     */
+    static inline void decryptBlocks(Schedule& schedule, const unsigned char* ciphertext, unsigned char* plaintext,
+                                     size_t len, size_t /*offset*/) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+        for (size_t i = 0; i < len; i += 8) {
+            DES_ecb_encrypt((const_DES_cblock*)(ciphertext + i), (DES_cblock*)(plaintext + i), &schedule,
+                            DES_DECRYPT);
+        }
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+    }
+
+    /**
+     * @brief Encrypts one 8-byte block.
+     */
+    static inline void encryptBlock(Schedule& schedule, const unsigned char* plaintext, unsigned char* ciphertext,
+                                    size_t /*offset*/) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+        DES_ecb_encrypt((const_DES_cblock*)plaintext, (DES_cblock*)ciphertext, &schedule, DES_ENCRYPT);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+    }
+
+    /**
+     * @brief Encrypts `len` bytes (a multiple of 8) in ECB mode, or in CBC mode from `iv`.
+     */
+    static inline void encrypt(const unsigned char* key, const unsigned char* plaintext, unsigned char* ciphertext,
+                               size_t len, const unsigned char* iv = nullptr, size_t /*offset*/ = 0) {
+        crypt(key, plaintext, ciphertext, len, iv, DES_ENCRYPT);
+    }
+
+    /**
+     * @brief Decrypts `len` bytes (a multiple of 8) in ECB mode, or in CBC mode from `iv`.
+     */
+    static inline void decrypt(const unsigned char* key, const unsigned char* ciphertext, unsigned char* plaintext,
+                               size_t len, const unsigned char* iv = nullptr, size_t /*offset*/ = 0) {
+        crypt(key, ciphertext, plaintext, len, iv, DES_DECRYPT);
+    }
+
+private:
+    static inline void crypt(const unsigned char* key, const unsigned char* in, unsigned char* out, size_t len,
+                             const unsigned char* iv, int direction) {
+        Schedule schedule;
+        setKey(key, schedule);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+        if (iv != nullptr) {
+            DES_cblock ivec;
+            memcpy(ivec, iv, 8);
+            DES_ncbc_encrypt(in, out, len, &schedule, &ivec, direction);
+        } else {
+            for (size_t i = 0; i < len; i += 8) {
+                DES_ecb_encrypt((const_DES_cblock*)(in + i), (DES_cblock*)(out + i), &schedule, direction);
+            }
+        }
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+    }
+};
+
+/**
+ * @brief The identity permutation every RC4 schedule starts from, built once at load time.
+ */
+static const struct Rc4Identity {
+    unsigned char s[256];
+    Rc4Identity() {
+        for (int i = 0; i < 256; ++i) {
+            s[i] = i;
+        }
+    }
+} kRc4Identity;
+
+/**
+ * @brief RC4 with a 40-bit key (export-grade SSL/TLS suites, legacy document formats).
+ * Key-space integers are the 5 key bytes, big-endian.
+ *
+ * Almost all the cost of a key is its schedule: 256 data-dependent swaps, which no two keys
+ * share. The schedule starts from a copy of the identity permutation (a vectorized 256-byte
+ * copy) and walks the 5 key bytes with a counter instead of a modulo. `setKeys` runs the
+ * schedules of 8 keys in lockstep: each swap chain is serial, but the 8 chains are
+ * independent, so their loads and stores overlap (about 2.5x the keys/s of one at a time;
+ * bytes cannot be scattered by SIMD stores, so this is instruction-level parallelism
+ * rather than vector code). Decryption then
+ * generates only the keystream up to the end of the window: `offset` bytes are skipped and
+ * `len` bytes XORed, on a copy of the permutation so the schedule can be reused (e.g. to
+ * verify a sweep hit).
+ */
+struct Rc4Cipher40 {
+    struct Schedule {
+        unsigned char s[256];
+    };
+    static const size_t kKeyBytes = 5;
+    static const size_t kBlockBytes = 8;
+    static const uint64_t kKeySpace = 1ULL << 40;
+    static const bool kStream = true;
+    static const size_t kBatch = 8;
+
+    static inline const char* name() { return "RC4-40"; }
+
+    /**
+     * @brief Converts a key-space integer to the 5-byte key (big-endian).
+     */
+    static inline void keyFromInteger(uint64_t key, unsigned char* bytes) {
+        for (int i = 0; i < 5; ++i) {
+            bytes[4 - i] = (key >> (i * 8)) & 0xFF;
+        }
+    }
+
+    /**
+     * @brief Runs the RC4 key-scheduling algorithm.
+     */
+    static inline void setKey(const unsigned char* key, Schedule& schedule) {
+        memcpy(schedule.s, kRc4Identity.s, sizeof(schedule.s));
+        unsigned char* s = schedule.s;
+        unsigned j = 0, k = 0;
+        for (unsigned i = 0; i < 256; ++i) {
+            j = (j + s[i] + key[k]) & 0xFF;
+            k = k == 4 ? 0 : k + 1;
+            std::swap(s[i], s[j]);
+        }
+    }
+
+    /**
+     * @brief Runs the key-scheduling algorithm of `count` keys, interleaved when there are kBatch.
+     */
+    static inline void setKeys(const unsigned char* keys, Schedule* schedules, size_t count) {
+        if (count != kBatch) {
+            for (size_t b = 0; b < count; ++b) {
+                setKey(keys + b * kKeyBytes, schedules[b]);
+            }
+            return;
+        }
+        for (size_t b = 0; b < kBatch; ++b) {
+            memcpy(schedules[b].s, kRc4Identity.s, sizeof(schedules[b].s));
+        }
+        unsigned j[kBatch] = {};
+        unsigned k = 0;
+        for (unsigned i = 0; i < 256; ++i) {
+            for (size_t b = 0; b < kBatch; ++b) {
+                unsigned char* s = schedules[b].s;
+                j[b] = (j[b] + s[i] + keys[b * kKeyBytes + k]) & 0xFF;
+                std::swap(s[i], s[j[b]]);
+            }
+            k = k == 4 ? 0 : k + 1;
+        }
+    }
+
+    static inline void decryptBlocks(Schedule& schedule, const unsigned char* ciphertext, unsigned char* plaintext,
+                                     size_t len, size_t offset) {
+        xorKeystream(schedule, ciphertext, plaintext, len, offset);
+    }
+
+    static inline void encryptBlock(Schedule& schedule, const unsigned char* plaintext, unsigned char* ciphertext,
+                                    size_t offset) {
+        xorKeystream(schedule, plaintext, ciphertext, kBlockBytes, offset);
+    }
+
+    /**
+     * @brief Encrypts `len` bytes that start `offset` bytes into the message (there is no IV).
+     */
+    static inline void encrypt(const unsigned char* key, const unsigned char* plaintext, unsigned char* ciphertext,
+                               size_t len, const unsigned char* /*iv*/ = nullptr, size_t offset = 0) {
+        Schedule schedule;
+        setKey(key, schedule);
+        xorKeystream(schedule, plaintext, ciphertext, len, offset);
+    }
+
+    /**
+     * @brief Decrypts `len` bytes that start `offset` bytes into the message (there is no IV).
+     */
+    static inline void decrypt(const unsigned char* key, const unsigned char* ciphertext, unsigned char* plaintext,
+                               size_t len, const unsigned char* /*iv*/ = nullptr, size_t offset = 0) {
+        encrypt(key, ciphertext, plaintext, len, nullptr, offset);
+    }
+
+private:
+    /// Writes `in` XOR the keystream bytes [offset, offset + len) to `out`.
+    static inline void xorKeystream(const Schedule& schedule, const unsigned char* in, unsigned char* out, size_t len,
+                                    size_t offset) {
+        unsigned char s[256];
+        memcpy(s, schedule.s, sizeof(s));
+        unsigned i = 0, j = 0;
+        for (size_t n = 0; n < offset + len; ++n) {
+            i = (i + 1) & 0xFF;
+            j = (j + s[i]) & 0xFF;
+            std::swap(s[i], s[j]);
+            if (n >= offset) {
+                out[n - offset] = in[n - offset] ^ s[(s[i] + s[j]) & 0xFF];
+            }
+        }
+    }
+};
+
+#endif  // CIPHER_POLICY_H
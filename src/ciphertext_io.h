@@ -0,0 +1,264 @@
+/**
+ * @file ciphertext_io.h
+ * @brief Loading ciphertext from raw, hex or base64 files, and writing test vectors.
+ *
+ * In the `plain` input format the drivers encrypt a plaintext file themselves (the demo
+ * mode). In the other formats the input file already holds the ciphertext:
+ *
+ * - `raw`: binary ciphertext. The file is memory-mapped and only the blocks covering the
+ *   crib are copied out, so large files are never read in full.
+ * - `hex`: hexadecimal text; whitespace is ignored.
+ * - `base64`: standard base64 text; whitespace is ignored.
+ *
+ * `writeCiphertext` produces such files from the demo mode, so the encrypt step doubles as
+ * a test-vector generator.
+ *
+ * @date October 2024
+ */
+
+#ifndef CIPHERTEXT_IO_H
+#define CIPHERTEXT_IO_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "job_descriptor.h"
+
+/**
+ * @brief Formats of the driver input file.
+ */
+enum CipherFormat {
+    FORMAT_PLAIN,   ///< Plaintext, encrypted by the driver with the given key.
+    FORMAT_RAW,     ///< Binary ciphertext.
+    FORMAT_HEX,     ///< Hexadecimal ciphertext.
+    FORMAT_BASE64   ///< Base64 ciphertext.
+};
+
+static const char* const kFormatNames[] = {"plain", "raw", "hex", "base64"};
+
+static const char kBase64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * @brief Parses an input format name.
+ *
+ * @return true If `name` is a known format.
+ */
+static inline bool parseCipherFormat(const std::string& name, CipherFormat& format) {
+    for (int f = FORMAT_PLAIN; f <= FORMAT_BASE64; ++f) {
+        if (name == kFormatNames[f]) {
+            format = static_cast<CipherFormat>(f);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Decodes hexadecimal text, skipping whitespace.
+ *
+ * @return true If the text is well-formed.
+ */
+static inline bool decodeHex(const std::string& text, std::vector<unsigned char>& out) {
+    out.clear();
+    int high = -1;
+    for (unsigned char c : text) {
+        if (std::isspace(c)) {
+            continue;
+        }
+        if (!std::isxdigit(c)) {
+            return false;
+        }
+        int nibble = std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10;
+        if (high < 0) {
+            high = nibble;
+        } else {
+            out.push_back(static_cast<unsigned char>(high << 4 | nibble));
+            high = -1;
+        }
+    }
+    return high < 0;
+}
+
+/**
+ * @brief Decodes base64 text, skipping whitespace.
+ *
+ * @return true If the text is well-formed.
+ */
+static inline bool decodeBase64(const std::string& text, std::vector<unsigned char>& out) {
+    out.clear();
+    uint32_t bits = 0;
+    int count = 0;
+    bool padding = false;
+    for (unsigned char c : text) {
+        if (std::isspace(c)) {
+            continue;
+        }
+        if (c == '=') {
+            padding = true;
+            continue;
+        }
+        const char* at = std::strchr(kBase64Alphabet, c);
+        if (padding || c == '\0' || at == nullptr) {
+            return false;
+        }
+        bits = bits << 6 | static_cast<uint32_t>(at - kBase64Alphabet);
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<unsigned char>(bits >> count));
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Encodes bytes as lowercase hexadecimal, 32 bytes per line.
+ */
+static inline std::string encodeHex(const unsigned char* data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < len; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 15];
+        if (i % 32 == 31 || i + 1 == len) {
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Encodes bytes as padded base64, 76 characters per line.
+ */
+static inline std::string encodeBase64(const unsigned char* data, size_t len) {
+    std::string out;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t bits = data[i] << 16 | (i + 1 < len ? data[i + 1] << 8 : 0) | (i + 2 < len ? data[i + 2] : 0);
+        out += kBase64Alphabet[bits >> 18 & 63];
+        out += kBase64Alphabet[bits >> 12 & 63];
+        out += i + 1 < len ? kBase64Alphabet[bits >> 6 & 63] : '=';
+        out += i + 2 < len ? kBase64Alphabet[bits & 63] : '=';
+        if (i % 57 == 54) {
+            out += '\n';
+        }
+    }
+    if (out.empty() || out.back() != '\n') {
+        out += '\n';
+    }
+    return out;
+}
+
+/**
+ * @brief Loads a ciphertext file and builds the job that searches it for `phrase`.
+ *
+ * @param path The ciphertext file.
+ * @param format Its format (not FORMAT_PLAIN).
+ * @param phrase The search phrase.
+ * @param cribOffset Offset of the phrase in the plaintext, or -1 when unknown.
+ * @param job Filled with the job.
+ * @param loaded Filled with the ciphertext that was loaded: the whole file for text formats,
+ *               only the job's blocks for memory-mapped raw files with a crib offset.
+ * @param error Set to a description of the problem on failure.
+ * @param iv The IV of a CBC ciphertext, or nullptr for ECB.
+ * @param blockBytes The ciphertext length must be a multiple of it (1 for a stream cipher).
+ * @return true If the job was built.
+ */
+static inline bool loadCiphertextJob(const std::string& path, CipherFormat format, const std::string& phrase,
+                                     long cribOffset, JobDescriptor& job, std::vector<unsigned char>& loaded,
+                                     std::string& error, const unsigned char* iv = nullptr, size_t blockBytes = 8) {
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+    void* mapped = MAP_FAILED;
+
+    if (format == FORMAT_RAW) {
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            error = "Failed to open input file.";
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+        length = st.st_size;
+        if (length > 0) {
+            mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (length > 0 && mapped == MAP_FAILED) {
+            error = "Failed to map input file.";
+            return false;
+        }
+        data = static_cast<const unsigned char*>(mapped);
+    } else {
+        std::ifstream in(path);
+        if (!in) {
+            error = "Failed to open input file.";
+            return false;
+        }
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        bool ok = format == FORMAT_HEX ? decodeHex(text, loaded) : decodeBase64(text, loaded);
+        if (!ok) {
+            error = std::string("Input file is not valid ") + kFormatNames[format] + ".";
+            return false;
+        }
+        data = loaded.data();
+        length = loaded.size();
+    }
+
+    bool ok = true;
+    if (length == 0 || length % blockBytes != 0) {
+        error = "Ciphertext length " + std::to_string(length) + " is not a positive multiple of " +
+                std::to_string(blockBytes) + ".";
+        ok = false;
+    } else if (cribOffset >= 0 && static_cast<size_t>(cribOffset) + phrase.size() > length) {
+        error = "The search phrase at the crib offset extends past the ciphertext.";
+        ok = false;
+    } else {
+        job = makeWindowJob(data, length, phrase, cribOffset, iv);
+        if (mapped != MAP_FAILED) {
+            loaded = job.ciphertext;
+        }
+    }
+
+    if (mapped != MAP_FAILED) {
+        munmap(mapped, length);
+    }
+    return ok;
+}
+
+/**
+ * @brief Writes a ciphertext test vector; the format follows the file extension.
+ *
+ * `.hex` files are written as hex, `.b64` and `.base64` files as base64, anything else raw.
+ *
+ * @return true If the file was written.
+ */
+static inline bool writeCiphertext(const std::string& path, const unsigned char* data, size_t len) {
+    auto endsWith = [&path](const std::string& suffix) {
+        return path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    std::string bytes;
+    if (endsWith(".hex")) {
+        bytes = encodeHex(data, len);
+    } else if (endsWith(".b64") || endsWith(".base64")) {
+        bytes = encodeBase64(data, len);
+    } else {
+        bytes.assign(reinterpret_cast<const char*>(data), len);
+    }
+    std::ofstream out(path, std::ios::binary);
+    out.write(bytes.data(), bytes.size());
+    return static_cast<bool>(out);
+}
+
+#endif  // CIPHERTEXT_IO_H
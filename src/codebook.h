@@ -0,0 +1,295 @@
+/**
+ * @file codebook.h
+ * @brief Sorted codebook E_k(P) -> k of one plaintext block over a reduced key space, built
+ * in parallel with MPI and read through a memory mapping.
+ *
+ * The build runs in two parallel phases:
+ *
+ * 1. Every rank encrypts P under its slice of the keys (OpenMP inside the rank), in runs
+ *    of at most `runKeys` keys that are sorted and written to run files next to the
+ *    table. Memory stays bounded however large the table is (an external merge sort).
+ * 2. The ciphertext space is cut into one bucket per rank. Every rank k-way merges its
+ *    bucket from all the runs and writes it at its final offset in the table, so the
+ *    table is assembled without any rank holding more than one run in memory. The run
+ *    files must be on a file system shared by all ranks (like the table itself).
+ *
+ * Used by des_codebook (lookups of single ciphertexts) and des_mitm (the first half of a
+ * meet-in-the-middle attack).
+ *
+ * @date October 2024
+ */
+
+#ifndef CODEBOOK_H
+#define CODEBOOK_H
+
+#include <mpi.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "des_tables.h"
+
+/// Identifies a codebook file (and its layout version).
+static const char kCodebookMagic[8] = {'D', 'E', 'S', 'C', 'B', 'K', '0', '1'};
+
+/**
+ * @brief Header at the start of a codebook file; the records follow it.
+ */
+struct CodebookHeader {
+    char magic[8];                ///< kCodebookMagic.
+    unsigned char plaintext[8];   ///< The known plaintext block.
+    uint32_t bits;                ///< Key indices [0, 2^bits) are tabulated.
+    uint32_t reserved;
+    uint64_t count;               ///< Number of records.
+};
+
+/**
+ * @brief One codebook entry. Blocks are stored big-endian as integers, so the numeric order
+ * of `block` is the byte order of the ciphertext.
+ */
+struct CodebookRecord {
+    uint64_t block;   ///< E_k(P).
+    uint64_t index;   ///< Key index k.
+
+    bool operator<(const CodebookRecord& other) const { return block < other.block; }
+};
+
+/**
+ * @brief Returns the merge bucket (0 .. buckets - 1) of a block.
+ */
+static inline int bucketOf(uint64_t block, int buckets) {
+    return static_cast<int>((static_cast<unsigned __int128>(block) * buckets) >> 64);
+}
+
+/**
+ * @brief Encrypts the plaintext block under keys [begin, end), filling `records`.
+ */
+static inline void encryptRange(const unsigned char* plaintext, uint64_t begin, uint64_t end,
+                                std::vector<CodebookRecord>& records) {
+    records.resize(end - begin);
+#pragma omp parallel for schedule(static)
+    for (uint64_t k = begin; k < end; ++k) {
+        records[k - begin].block = encryptUnderIndex(k, plaintext);
+        records[k - begin].index = k;
+    }
+}
+
+/**
+ * @brief Sequential reader of the records of one bucket of a run file.
+ */
+class RunSegment {
+public:
+    RunSegment(const std::string& path, uint64_t first, uint64_t count) : in(path, std::ios::binary), left(count), at(0) {
+        in.seekg(first * sizeof(CodebookRecord));
+    }
+
+    /// Fetches the next record; false at the end of the segment.
+    bool next(CodebookRecord& record) {
+        if (at == buffer.size()) {
+            size_t n = std::min<uint64_t>(left, 1 << 16);
+            if (n == 0) {
+                return false;
+            }
+            buffer.resize(n);
+            in.read(reinterpret_cast<char*>(buffer.data()), n * sizeof(CodebookRecord));
+            left -= n;
+            at = 0;
+        }
+        record = buffer[at++];
+        return true;
+    }
+
+private:
+    std::ifstream in;
+    uint64_t left;
+    std::vector<CodebookRecord> buffer;
+    size_t at;
+};
+
+/**
+ * @brief Size and timing of a codebook build.
+ */
+struct CodebookStats {
+    uint64_t count = 0;          ///< Records in the table.
+    double encryptSeconds = 0;   ///< Encrypt-and-sort phase.
+    double mergeSeconds = 0;     ///< Merge phase.
+};
+
+/**
+ * @brief Builds a codebook in two parallel phases (see the file comment). Collective over `comm`.
+ *
+ * @param comm The communicator of the build.
+ * @param path The table file; run files are written next to it.
+ * @param plaintext The known plaintext block.
+ * @param bits Key indices [0, 2^bits) are tabulated.
+ * @param runKeys Keys per sorted run (bounds the memory of every rank).
+ * @param stats Filled with the size and timing of the build.
+ * @param error Set to a description of the problem on failure.
+ * @return true On every process if the table was written.
+ */
+static inline bool buildCodebook(MPI_Comm comm, const std::string& path, const unsigned char* plaintext, int bits,
+                                 uint64_t runKeys, CodebookStats& stats, std::string& error) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    // Phase 1: sorted runs of this rank's slice of the keys
+    auto start = Clock::now();
+    uint64_t keyspace = 1ULL << bits;
+    uint64_t perRank = keyspace / numProcesses;
+    uint64_t sliceBegin = perRank * processId;
+    uint64_t sliceEnd = (processId == numProcesses - 1) ? keyspace : sliceBegin + perRank;
+
+    std::vector<std::string> myRuns;
+    std::vector<uint64_t> myCounts;  // Records of every bucket, run after run
+    std::vector<CodebookRecord> records;
+    bool ok = true;
+    for (uint64_t begin = sliceBegin; begin < sliceEnd; begin += runKeys) {
+        uint64_t end = std::min(begin + runKeys, sliceEnd);
+        encryptRange(plaintext, begin, end, records);
+        std::sort(records.begin(), records.end());
+
+        std::string runPath = path + ".run" + std::to_string(processId) + "." + std::to_string(myRuns.size());
+        std::ofstream out(runPath, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CodebookRecord));
+        ok = ok && static_cast<bool>(out);
+        myRuns.push_back(runPath);
+
+        std::vector<uint64_t> counts(numProcesses, 0);
+        for (const CodebookRecord& r : records) {
+            ++counts[bucketOf(r.block, numProcesses)];
+        }
+        myCounts.insert(myCounts.end(), counts.begin(), counts.end());
+    }
+    std::vector<CodebookRecord>().swap(records);
+
+    int allOk = ok;
+    MPI_Allreduce(MPI_IN_PLACE, &allOk, 1, MPI_INT, MPI_LAND, comm);
+    if (!allOk) {
+        error = "Failed to write the run files next to " + path;
+        return false;
+    }
+    stats.encryptSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Every rank learns every run's bucket sizes
+    int myRunCount = myRuns.size();
+    std::vector<int> runCounts(numProcesses);
+    MPI_Allgather(&myRunCount, 1, MPI_INT, runCounts.data(), 1, MPI_INT, comm);
+    std::vector<int> countsPerRank(numProcesses), displacements(numProcesses);
+    int totalRuns = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        countsPerRank[r] = runCounts[r] * numProcesses;
+        displacements[r] = totalRuns * numProcesses;
+        totalRuns += runCounts[r];
+    }
+    std::vector<uint64_t> allCounts(static_cast<size_t>(totalRuns) * numProcesses);
+    MPI_Allgatherv(myCounts.data(), myCounts.size(), MPI_UINT64_T, allCounts.data(), countsPerRank.data(),
+                   displacements.data(), MPI_UINT64_T, comm);
+
+    // Phase 2: merge this rank's bucket from every run and write it at its offset in the table
+    auto mergeStart = Clock::now();
+    uint64_t before = 0, total = 0;
+    for (int run = 0; run < totalRuns; ++run) {
+        for (int b = 0; b < numProcesses; ++b) {
+            uint64_t n = allCounts[static_cast<size_t>(run) * numProcesses + b];
+            total += n;
+            if (b < processId) {
+                before += n;
+            }
+        }
+    }
+
+    std::string tmpPath = path + ".tmp";
+    if (processId == 0) {
+        CodebookHeader header = {};
+        memcpy(header.magic, kCodebookMagic, 8);
+        memcpy(header.plaintext, plaintext, 8);
+        header.bits = bits;
+        header.count = total;
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    MPI_Barrier(comm);
+
+    std::vector<std::unique_ptr<RunSegment>> segments;
+    int run = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        for (int i = 0; i < runCounts[r]; ++i, ++run) {
+            const uint64_t* counts = &allCounts[static_cast<size_t>(run) * numProcesses];
+            uint64_t first = 0;
+            for (int b = 0; b < processId; ++b) {
+                first += counts[b];
+            }
+            std::string runPath = path + ".run" + std::to_string(r) + "." + std::to_string(i);
+            segments.emplace_back(new RunSegment(runPath, first, counts[processId]));
+        }
+    }
+
+    typedef std::pair<CodebookRecord, size_t> Head;
+    auto later = [](const Head& a, const Head& b) { return b.first < a.first; };
+    std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+    for (size_t s = 0; s < segments.size(); ++s) {
+        CodebookRecord record;
+        if (segments[s]->next(record)) {
+            heads.push(Head(record, s));
+        }
+    }
+
+    int fd = open(tmpPath.c_str(), O_WRONLY);
+    off_t offset = sizeof(CodebookHeader) + before * sizeof(CodebookRecord);
+    std::vector<CodebookRecord> out;
+    out.reserve(1 << 16);
+    auto flush = [&]() {
+        size_t bytes = out.size() * sizeof(CodebookRecord);
+        ok = ok && fd >= 0 && pwrite(fd, out.data(), bytes, offset) == static_cast<ssize_t>(bytes);
+        offset += bytes;
+        out.clear();
+    };
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        out.push_back(head.first);
+        if (out.size() == out.capacity()) {
+            flush();
+        }
+        if (segments[head.second]->next(head.first)) {
+            heads.push(head);
+        }
+    }
+    flush();
+    if (fd >= 0) {
+        close(fd);
+    }
+    segments.clear();
+    for (const std::string& runPath : myRuns) {
+        std::remove(runPath.c_str());
+    }
+
+    allOk = ok;
+    MPI_Allreduce(MPI_IN_PLACE, &allOk, 1, MPI_INT, MPI_LAND, comm);
+    if (processId == 0) {
+        if (!allOk || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            std::remove(tmpPath.c_str());
+            allOk = 0;
+        }
+    }
+    MPI_Bcast(&allOk, 1, MPI_INT, 0, comm);  // The table is in place once this returns
+    if (!allOk) {
+        error = "Failed to write " + path;
+        return false;
+    }
+    stats.count = total;
+    stats.mergeSeconds = std::chrono::duration<double>(Clock::now() - mergeStart).count();
+    return true;
+}
+
+#endif  // CODEBOOK_H
@@ -0,0 +1,137 @@
+/**
+ * @file corpus.h
+ * @brief Streaming enumeration of the ciphertext files of a corpus.
+ *
+ * A corpus is either a directory, whose regular files (except hidden ones) are the
+ * ciphertexts, or a manifest file listing one ciphertext per line:
+ *
+ *     # path [crib_offset]
+ *     tickets/0001.bin 5
+ *     tickets/0002.bin
+ *
+ * Relative paths in a manifest are resolved against the manifest's directory; a missing
+ * crib offset falls back to the `--crib-offset` option. Entries are read one at a time, so
+ * a corpus of any size is never listed in memory.
+ *
+ * @date October 2024
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief How the ciphertexts of a corpus are searched.
+ */
+enum CorpusMode {
+    CORPUS_JOBS,   ///< One job per ciphertext, run one after the other by all ranks.
+    CORPUS_SWEEP   ///< One sweep of the key space that tests every ciphertext at once.
+};
+
+static const char* const kCorpusModeNames[] = {"jobs", "sweep"};
+
+/**
+ * @brief One ciphertext of a corpus.
+ */
+struct CorpusEntry {
+    std::string path;      ///< Ciphertext file.
+    long cribOffset = -1;  ///< Offset of the phrase in the plaintext; -1 when unknown.
+};
+
+/**
+ * @brief Reads the entries of a corpus directory or manifest one at a time.
+ */
+class CorpusReader {
+public:
+    CorpusReader() : dir(nullptr), defaultCribOffset(-1) {}
+
+    ~CorpusReader() {
+        if (dir != nullptr) {
+            closedir(dir);
+        }
+    }
+
+    /**
+     * @brief Opens a corpus.
+     *
+     * @param path Directory or manifest file.
+     * @param cribOffset Crib offset of entries that do not give their own.
+     * @param error Set to a description of the problem on failure.
+     * @return true If the corpus was opened.
+     */
+    bool open(const std::string& path, long cribOffset, std::string& error) {
+        defaultCribOffset = cribOffset;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            error = "Cannot open corpus " + path;
+            return false;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            dir = opendir(path.c_str());
+            base = path + "/";
+            if (dir == nullptr) {
+                error = "Cannot read corpus directory " + path;
+                return false;
+            }
+            return true;
+        }
+        manifest.reset(new std::ifstream(path));
+        size_t slash = path.rfind('/');
+        base = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+        if (!*manifest) {
+            error = "Cannot read corpus manifest " + path;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns the next entry.
+     *
+     * @return false When the corpus is exhausted.
+     */
+    bool next(CorpusEntry& entry) {
+        if (dir != nullptr) {
+            while (struct dirent* e = readdir(dir)) {
+                if (e->d_name[0] == '.') {
+                    continue;
+                }
+                entry.path = base + e->d_name;
+                entry.cribOffset = defaultCribOffset;
+                struct stat st;
+                if (stat(entry.path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        std::string line;
+        while (manifest && std::getline(*manifest, line)) {
+            std::istringstream fields(line);
+            std::string path;
+            if (!(fields >> path) || path[0] == '#') {
+                continue;
+            }
+            entry.path = path[0] == '/' ? path : base + path;
+            if (!(fields >> entry.cribOffset)) {
+                entry.cribOffset = defaultCribOffset;
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    DIR* dir;
+    std::unique_ptr<std::ifstream> manifest;
+    std::string base;
+    long defaultCribOffset;
+};
+
+#endif  // CORPUS_H
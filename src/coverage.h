@@ -0,0 +1,271 @@
+/**
+ * @file coverage.h
+ * @brief Chunk order by key prior, checkpoints and coverage reports for time-bounded searches.
+ *
+ * The key space is cut into fixed-size chunks and every rank searches its own sequence of
+ * them in order, so the progress of a rank is fully described by the number of chunks it
+ * has completed. The order of the chunks follows the configured prior:
+ *
+ * - `uniform`: every key is equally likely; each rank scans one contiguous slice of the key
+ *   space (the original static split).
+ * - `low-first`: small key values are more likely (keys typed as small integers, short
+ *   numeric PINs, ...); chunk c goes to rank c % ranks, so all ranks sweep the key space
+ *   together from key 0 upwards. The prior mass of the keys below x is taken to be
+ *   log2(x + 1) / bits (log-uniform over the key magnitude).
+ *
+ * A checkpoint records the completed chunks of every rank; a search started with the same
+ * checkpoint file resumes where the previous one stopped.
+ *
+ * @date October 2024
+ */
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Prior over the key values, which decides the order the chunks are searched in.
+ */
+enum KeyPrior {
+    PRIOR_UNIFORM,    ///< Every key equally likely; contiguous slice per rank.
+    PRIOR_LOW_FIRST   ///< Small keys more likely; chunks interleaved over the ranks from key 0.
+};
+
+static const char* const kPriorNames[] = {"uniform", "low-first"};
+
+/**
+ * @brief Parses a prior name.
+ *
+ * @return true If `name` is a known prior.
+ */
+static inline bool parseKeyPrior(const std::string& name, KeyPrior& prior) {
+    for (int p = PRIOR_UNIFORM; p <= PRIOR_LOW_FIRST; ++p) {
+        if (name == kPriorNames[p]) {
+            prior = static_cast<KeyPrior>(p);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Assignment of the chunks of a key space to the ranks.
+ */
+struct ChunkPlan {
+    KeyPrior prior;
+    uint64_t keyspace;   ///< Number of keys (a power of two).
+    uint64_t chunkSize;  ///< Keys per chunk.
+    int numRanks;
+
+    /// Total number of chunks in the key space.
+    uint64_t totalChunks() const { return (keyspace + chunkSize - 1) / chunkSize; }
+
+    /// Number of chunks in the sequence of `rank`.
+    uint64_t chunksOf(int rank) const {
+        if (prior == PRIOR_LOW_FIRST) {
+            uint64_t total = totalChunks();
+            return total / numRanks + (static_cast<uint64_t>(rank) < total % numRanks ? 1 : 0);
+        }
+        uint64_t begin, end;
+        slice(rank, begin, end);
+        return (end - begin + chunkSize - 1) / chunkSize;
+    }
+
+    /// Key range [begin, end) of the index-th chunk of `rank`.
+    void chunk(int rank, uint64_t index, uint64_t& begin, uint64_t& end) const {
+        if (prior == PRIOR_LOW_FIRST) {
+            begin = (index * numRanks + rank) * chunkSize;
+            end = std::min(begin + chunkSize, keyspace);
+            return;
+        }
+        uint64_t sliceBegin, sliceEnd;
+        slice(rank, sliceBegin, sliceEnd);
+        begin = sliceBegin + index * chunkSize;
+        end = std::min(begin + chunkSize, sliceEnd);
+    }
+
+    /// Prior probability that the key lies in [begin, end).
+    double priorMass(uint64_t begin, uint64_t end) const {
+        if (prior == PRIOR_LOW_FIRST) {
+            return (std::log2(static_cast<double>(end) + 1) - std::log2(static_cast<double>(begin) + 1)) /
+                   std::log2(static_cast<double>(keyspace));
+        }
+        return static_cast<double>(end - begin) / keyspace;
+    }
+
+private:
+    /// Contiguous slice of `rank` under the uniform prior; the last rank takes the remainder.
+    void slice(int rank, uint64_t& begin, uint64_t& end) const {
+        uint64_t perRank = keyspace / numRanks;
+        begin = perRank * rank;
+        end = (rank == numRanks - 1) ? keyspace : begin + perRank;
+    }
+};
+
+/**
+ * @brief Reads the completed-chunk counts of a checkpoint written for the same plan.
+ *
+ * @param path The checkpoint file.
+ * @param plan The plan of the current search.
+ * @param completed Filled with the number of completed chunks per rank.
+ * @param error Set to a description of the problem when the checkpoint cannot be used.
+ * @return true If the checkpoint was read and matches the plan.
+ */
+static inline bool readCheckpoint(const std::string& path, const ChunkPlan& plan,
+                                  std::vector<uint64_t>& completed, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::string line, prior;
+    uint64_t keyspace = 0, chunkSize = 0;
+    int ranks = 0;
+    completed.assign(plan.numRanks, 0);
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        fields >> name;
+        if (name == "prior") {
+            fields >> prior;
+        } else if (name == "keyspace") {
+            fields >> keyspace;
+        } else if (name == "chunk_size") {
+            fields >> chunkSize;
+        } else if (name == "ranks") {
+            fields >> ranks;
+        } else if (name == "rank") {
+            int r;
+            uint64_t chunks;
+            if (fields >> r >> chunks && r >= 0 && r < plan.numRanks) {
+                completed[r] = std::min(chunks, plan.chunksOf(r));
+            }
+        }
+    }
+    if (prior != kPriorNames[plan.prior] || keyspace != plan.keyspace || chunkSize != plan.chunkSize ||
+        ranks != plan.numRanks) {
+        error = path + " was written for a different prior, key space, chunk size or rank count";
+        completed.assign(plan.numRanks, 0);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the completed-chunk counts of every rank, replacing the file atomically.
+ *
+ * @return true If the checkpoint was written.
+ */
+static inline bool writeCheckpoint(const std::string& path, const ChunkPlan& plan,
+                                   const std::vector<uint64_t>& completed) {
+    std::string tmpPath = path + ".tmp";
+    FILE* out = fopen(tmpPath.c_str(), "w");
+    if (!out) {
+        return false;
+    }
+    std::fprintf(out, "# Key search checkpoint: chunks completed per rank, in search order\n");
+    std::fprintf(out, "prior %s\nkeyspace %llu\nchunk_size %llu\nranks %d\n", kPriorNames[plan.prior],
+                 static_cast<unsigned long long>(plan.keyspace), static_cast<unsigned long long>(plan.chunkSize),
+                 plan.numRanks);
+    for (int r = 0; r < plan.numRanks; ++r) {
+        std::fprintf(out, "rank %d %llu\n", r, static_cast<unsigned long long>(completed[r]));
+    }
+    bool ok = fclose(out) == 0;
+    return ok && std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+/**
+ * @brief Returns the index of the first chunk this rank still has to search.
+ *
+ * Process 0 reads the checkpoint (when the file exists) and scatters the counts.
+ * Collective over `comm`.
+ */
+static inline uint64_t resumeFromCheckpoint(MPI_Comm comm, const ChunkPlan& plan, const std::string& path) {
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<uint64_t> completed;
+    if (processId == 0) {
+        std::string error;
+        if (!path.empty() && std::ifstream(path)) {
+            if (readCheckpoint(path, plan, completed, error)) {
+                std::printf("Resuming from checkpoint %s\n", path.c_str());
+            } else {
+                std::fprintf(stderr, "Ignoring checkpoint: %s\n", error.c_str());
+            }
+        } else {
+            completed.assign(plan.numRanks, 0);
+        }
+    }
+    uint64_t first = 0;
+    MPI_Scatter(completed.data(), 1, MPI_UINT64_T, &first, 1, MPI_UINT64_T, 0, comm);
+    return first;
+}
+
+/**
+ * @brief Gathers the number of completed chunks of every rank on process 0.
+ *
+ * Collective over `comm`; the result is empty on the other processes.
+ */
+static inline std::vector<uint64_t> gatherCompleted(MPI_Comm comm, const ChunkPlan& plan, uint64_t completed) {
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<uint64_t> all(processId == 0 ? plan.numRanks : 0);
+    MPI_Gather(&completed, 1, MPI_UINT64_T, all.data(), 1, MPI_UINT64_T, 0, comm);
+    return all;
+}
+
+/**
+ * @brief Gathers the completed chunks of every rank, writes the checkpoint and prints the
+ * fraction of the key space and of the prior mass covered.
+ *
+ * Collective over `comm`.
+ *
+ * @param comm The communicator of the search.
+ * @param plan The plan of the search.
+ * @param completed Number of chunks of its sequence the calling rank has completed.
+ * @param path Checkpoint file; empty to only print the report.
+ */
+static inline void reportCoverage(MPI_Comm comm, const ChunkPlan& plan, uint64_t completed, const std::string& path) {
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<uint64_t> all = gatherCompleted(comm, plan, completed);
+    if (processId != 0) {
+        return;
+    }
+
+    uint64_t keysCovered = 0;
+    double massCovered = 0;
+    for (int r = 0; r < plan.numRanks; ++r) {
+        for (uint64_t i = 0; i < all[r]; ++i) {
+            uint64_t begin, end;
+            plan.chunk(r, i, begin, end);
+            keysCovered += end - begin;
+            massCovered += plan.priorMass(begin, end);
+        }
+    }
+    std::printf("Coverage: %llu of %llu keys (%.6g%%), %.6g%% of the %s prior mass\n",
+                static_cast<unsigned long long>(keysCovered), static_cast<unsigned long long>(plan.keyspace),
+                100.0 * keysCovered / plan.keyspace, 100.0 * massCovered, kPriorNames[plan.prior]);
+    if (!path.empty()) {
+        if (writeCheckpoint(path, plan, all)) {
+            std::printf("Checkpoint written to %s\n", path.c_str());
+        } else {
+            std::fprintf(stderr, "Failed to write checkpoint %s\n", path.c_str());
+        }
+    }
+    std::fflush(stdout);
+}
+
+#endif  // COVERAGE_H
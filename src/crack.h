@@ -0,0 +1,156 @@
+/**
+ * @file crack.h
+ * @brief Distributed candidate loop shared by the password and key crackers.
+ *
+ * Every rank tests a contiguous slice of an index range with OpenMP, in chunks. After each
+ * chunk the ranks exchange the targets they cracked as (target, index) pairs, so every
+ * rank knows which targets are left and the search ends as soon as none is. The indices
+ * are candidate passwords (candidates.h, in chunks of kCrackChunk) or key indices; the
+ * passwords or keys are never sent, as any rank can rebuild them from the index.
+ *
+ * @date October 2024
+ */
+
+#ifndef CRACK_H
+#define CRACK_H
+
+#include <mpi.h>
+#include <omp.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "candidates.h"
+
+/// Candidates tested by every rank between two exchanges of the cracked targets.
+static const uint64_t kCrackChunk = 1 << 16;
+
+/**
+ * @brief Outcome of a cracking run, identical on every process.
+ */
+struct CrackResult {
+    std::vector<uint64_t> solvedBy;  ///< Per target: index of the candidate that cracked it, plus one (0: not cracked).
+    uint64_t tested = 0;             ///< Candidates tested over all ranks.
+    uint64_t rejected = 0;           ///< Hits refuted by a full check, over all ranks.
+    double seconds = 0;              ///< Wall time of the run.
+};
+
+/**
+ * @brief Tests every index of [start, start + count) against the targets until all are cracked.
+ * Collective over `comm`.
+ *
+ * Every rank takes a contiguous slice of the range and tests it in chunks of `chunk` indices
+ * with OpenMP; after each chunk the ranks exchange their hits.
+ *
+ * @tparam State Per-thread scratch state (e.g. a candidate buffer or a key schedule),
+ *               default-constructed once per thread and chunk.
+ * @param chunk Indices tested by every rank between two exchanges.
+ * @param test Called as test(index, state, solved, hits, rejected) from the OpenMP threads:
+ *             appends the targets the index cracks to `hits` and counts the hits it refuted
+ *             in `rejected`; `solved` flags the targets already cracked.
+ * @param update Called as update(solved) on every process after each exchange.
+ * @return The result; `solvedBy` holds indices of the range, the lowest one that cracked each target.
+ */
+template <typename State, typename Test, typename Update>
+static inline CrackResult crackRange(MPI_Comm comm, uint64_t start, uint64_t count, uint64_t chunk,
+                                     size_t numTargets, Test test, Update update) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    auto begin = Clock::now();
+    uint64_t perRank = count / numProcesses;
+    uint64_t first = start + perRank * processId;
+    uint64_t last = (processId == numProcesses - 1) ? start + count : first + perRank;
+
+    CrackResult result;
+    result.solvedBy.assign(numTargets, 0);
+    std::vector<char> solved(numTargets, 0);
+    size_t remaining = numTargets;
+    uint64_t tested = 0, rejected = 0;
+    for (uint64_t at = first; remaining > 0; at += chunk) {
+        uint64_t end = std::min(at + chunk, last);
+        std::vector<uint64_t> mine;  // (target, index) pairs
+#pragma omp parallel reduction(+ : rejected)
+        {
+            State state;
+            std::vector<uint32_t> hits;
+            std::vector<uint64_t> local;
+#pragma omp for schedule(dynamic, 256) nowait
+            for (uint64_t i = at; i < end; ++i) {
+                hits.clear();
+                test(i, state, solved, hits, rejected);
+                for (uint32_t t : hits) {
+                    local.push_back(t);
+                    local.push_back(i);
+                }
+            }
+#pragma omp critical
+            mine.insert(mine.end(), local.begin(), local.end());
+        }
+        tested += end > at ? end - at : 0;
+
+        // Share the cracked targets; the lowest index to crack a target wins
+        int sendCount = mine.size();
+        std::vector<int> counts(numProcesses), displs(numProcesses, 0);
+        MPI_Allgather(&sendCount, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+        int received = 0;
+        for (int r = 0; r < numProcesses; ++r) {
+            displs[r] = received;
+            received += counts[r];
+        }
+        std::vector<uint64_t> all(received);
+        MPI_Allgatherv(mine.data(), sendCount, MPI_UINT64_T, all.data(), counts.data(), displs.data(), MPI_UINT64_T,
+                       comm);
+        for (int i = 0; i < received; i += 2) {
+            uint64_t t = all[i];
+            if (!solved[t] || all[i + 1] + 1 < result.solvedBy[t]) {
+                remaining -= !solved[t];
+                solved[t] = 1;
+                result.solvedBy[t] = all[i + 1] + 1;
+            }
+        }
+        update(solved);
+
+        int more = at + chunk < last;
+        MPI_Allreduce(MPI_IN_PLACE, &more, 1, MPI_INT, MPI_LOR, comm);
+        if (!more) {
+            break;
+        }
+    }
+
+    uint64_t counters[2] = {tested, rejected};
+    MPI_Allreduce(MPI_IN_PLACE, counters, 2, MPI_UINT64_T, MPI_SUM, comm);
+    result.tested = counters[0];
+    result.rejected = counters[1];
+    result.seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    return result;
+}
+
+/**
+ * @brief Tests every candidate against the targets until all are cracked. Collective over `comm`.
+ *
+ * @param candidates The candidates.
+ * @param numTargets Number of targets.
+ * @param test Called as test(candidate, solved, hits, rejected) from the OpenMP threads:
+ *             appends the targets the candidate cracks to `hits` and counts the hits it
+ *             refuted in `rejected`; `solved` flags the targets already cracked.
+ * @param update Called as update(solved) on every process after each exchange.
+ */
+template <typename Test, typename Update>
+static inline CrackResult crackTargets(MPI_Comm comm, const Candidates& candidates, size_t numTargets, Test test,
+                                       Update update) {
+    return crackRange<std::string>(
+        comm, 0, candidates.count(), kCrackChunk, numTargets,
+        [&](uint64_t i, std::string& candidate, const std::vector<char>& solved, std::vector<uint32_t>& hits,
+            uint64_t& rejected) {
+            candidates.at(i, candidate);
+            test(candidate, solved, hits, rejected);
+        },
+        update);
+}
+
+#endif  // CRACK_H
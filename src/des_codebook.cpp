@@ -0,0 +1,161 @@
+/**
+ * @file des_codebook.cpp
+ * @brief Full codebook of one known plaintext block over a reduced DES key space.
+ *
+ * For keys restricted to a small range (2^b keys, see des_keyspace.h) every ciphertext of a
+ * fixed plaintext block P can be precomputed once. The codebook is a file of E_k(P) -> k
+ * records sorted by ciphertext; a lookup memory-maps it and binary-searches, so a query
+ * costs O(log n) page reads instead of a 2^b-key search.
+ *
+ * The build runs under MPI, in sorted runs of `--run-keys` keys merged in parallel by
+ * ciphertext bucket (see codebook.h).
+ *
+ * Usage:
+ *
+ *     mpirun -np 8 ./des_codebook build table.cb --plaintext 'Esta es ' --bits 32
+ *     ./des_codebook lookup table.cb 6a7f1e22c0b93d45 ...   # or one block per line on stdin
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o des_codebook des_codebook.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <cstring>
+#include <mpi.h>
+#include <omp.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "codebook.h"
+
+/**
+ * @brief Builds the codebook and reports it. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int build(MPI_Comm comm, const std::string& path, const unsigned char* plaintext, int bits, uint64_t runKeys) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    CodebookStats stats;
+    std::string error;
+    bool ok = buildCodebook(comm, path, plaintext, bits, runKeys, stats, error);
+    if (processId == 0) {
+        if (!ok) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::cout << "Codebook " << path << ": " << stats.count << " keys (" << bits << " bits), "
+                  << stats.count * sizeof(CodebookRecord) / 1048576.0 << " MiB" << std::endl;
+        std::cout << "Encrypt and sort: " << stats.encryptSeconds << " s, merge: " << stats.mergeSeconds << " s on "
+                  << numProcesses << " processes" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief Answers ciphertext queries from a codebook.
+ *
+ * @return Process exit status.
+ */
+static int lookup(const std::string& path, std::vector<std::string> queries) {
+    MappedTable<CodebookHeader, CodebookRecord> table;
+    std::string error;
+    if (!table.open(path, kCodebookMagic, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    bool fromStdin = queries.empty();
+    std::string line;
+    int status = 0;
+    for (size_t q = 0; fromStdin ? static_cast<bool>(std::getline(std::cin, line)) : q < queries.size(); ++q) {
+        std::string query = fromStdin ? line : queries[q];
+        std::vector<unsigned char> bytes;
+        if (!decodeHex(query, bytes) || bytes.size() != 8) {
+            std::cerr << "Not an 8-byte hex block: " << query << std::endl;
+            status = 1;
+            continue;
+        }
+        CodebookRecord probe = {blockToWord(bytes.data()), 0};
+        auto range = std::equal_range(table.begin(), table.end(), probe);
+        std::string hex = blockToHex(bytes.data());
+        if (range.first == range.second) {
+            std::cout << hex << ": not in the codebook" << std::endl;
+            continue;
+        }
+        for (const CodebookRecord* r = range.first; r != range.second; ++r) {
+            unsigned char key[8];
+            indexToDesKey(r->index, key);
+            std::cout << hex << ": key index " << r->index << " (key " << blockToHex(key) << ")" << std::endl;
+        }
+    }
+    return status;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  mpirun -np <n> " << program << " build <table> (--plaintext <text> | --plaintext-hex <hex>)\n"
+              << "      --bits <b> [--threads <n>] [--run-keys <n>]\n"
+              << "  " << program << " lookup <table> [<ciphertext block hex> ...]   (blocks on stdin if none)\n"
+              << "Defaults: --threads 4 --run-keys 16777216" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::string command = argc > 2 ? argv[1] : "";
+    int status = 1;
+    if (command == "lookup") {
+        if (processId == 0) {
+            status = lookup(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        }
+    } else if (command == "build") {
+        std::string plaintextArg;
+        bool hex = false;
+        int bits = 0, threads = 4;
+        uint64_t runKeys = 1ULL << 24;
+        bool valid = true;
+        for (int i = 3; i < argc && valid; i += 2) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                valid = false;
+                break;
+            }
+            std::string value = argv[i + 1];
+            if (arg == "--plaintext" || arg == "--plaintext-hex") {
+                plaintextArg = value;
+                hex = arg == "--plaintext-hex";
+            } else if (arg == "--bits") {
+                bits = std::atoi(value.c_str());
+            } else if (arg == "--threads") {
+                threads = std::atoi(value.c_str());
+            } else if (arg == "--run-keys") {
+                runKeys = std::strtoull(value.c_str(), nullptr, 10);
+            } else {
+                valid = false;
+            }
+        }
+        unsigned char plaintext[8];
+        valid = valid && bits >= 1 && bits <= kDesKeyBits && threads > 0 && runKeys > 0 &&
+                parseBlock(plaintextArg, hex, plaintext);
+        if (valid) {
+            omp_set_num_threads(threads);
+            status = build(comm, argv[2], plaintext, bits, runKeys);
+        } else if (processId == 0) {
+            printUsage(argv[0]);
+        }
+    } else if (processId == 0) {
+        printUsage(argv[0]);
+    }
+
+    MPI_Finalize();
+    return status;
+}
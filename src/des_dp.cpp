@@ -0,0 +1,470 @@
+/**
+ * @file des_dp.cpp
+ * @brief Distributed time-memory trade-off with distinguished points, sharded over the MPI ranks.
+ *
+ * Chains follow one step function f(k) = R(E_k(P)) (des_tables.h) from a random start
+ * until they reach a distinguished point: a key index whose top `--dp-bits` bits are zero.
+ * Chains are about 2^dp-bits steps long; those still running after `--max-length` steps
+ * (loops) are dropped. Only (end point, start, length) is kept.
+ *
+ * Unlike a rainbow table (des_rainbow.cpp) there is no central table: every rank builds
+ * its own chains and sends each end point to the rank that owns it (hash of the end
+ * point), which keeps, sorts and writes its shard on its own. The build scales linearly
+ * with the ranks and never sorts the whole table in one place.
+ *
+ * A lookup runs on as many ranks as there are shards. Process 0 broadcasts the ciphertext
+ * blocks, each rank walks its share of them to their distinguished point, and the walk is
+ * sent to the owner of that point, which resolves it against its shard: it regenerates the
+ * stored chain from its start and checks whether it goes through the key. The key space
+ * is [0, 2^bits) in key indices (des_keyspace.h):
+ *
+ *     mpirun -np 4 ./des_dp build dp24 --plaintext 'Esta es ' --bits 24 --dp-bits 8
+ *     mpirun -np 4 ./des_dp lookup dp24 0123456789abcdef ...   # or one block per line on stdin
+ *
+ * The shards are the files `<table>.<r>of<n>`.
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o des_dp des_dp.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <mpi.h>
+#include <omp.h>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "des_tables.h"
+
+/// Identifies a distinguished-point shard file (and its layout version).
+static const char kDpMagic[8] = {'D', 'E', 'S', 'D', 'P', 'T', '0', '1'};
+
+/**
+ * @brief Header at the start of every shard; the chains of the shard follow it.
+ */
+struct DpHeader {
+    char magic[8];                ///< kDpMagic.
+    unsigned char plaintext[8];   ///< The known plaintext block.
+    uint32_t bits;                ///< Key indices [0, 2^bits) are covered.
+    uint32_t dpBits;              ///< Distinguished points have their top dpBits bits zero.
+    uint32_t maxLength;           ///< Longest chain kept.
+    uint32_t tableIndex;          ///< Selects the reduction function.
+    uint32_t shard;               ///< Index of this shard.
+    uint32_t shards;              ///< Number of shards (ranks of the build).
+    uint64_t count;               ///< Number of chains in this shard.
+};
+
+/**
+ * @brief One stored chain, sorted by end point.
+ */
+struct DpChain {
+    uint64_t end;      ///< The distinguished point.
+    uint64_t start;    ///< First key index.
+    uint64_t length;   ///< Steps from start to end.
+
+    bool operator<(const DpChain& other) const {
+        return end < other.end || (end == other.end && length > other.length);
+    }
+};
+
+/**
+ * @brief The step function and distinguishing property of one table.
+ */
+struct DpSpec {
+    const unsigned char* plaintext;
+    uint32_t bits;
+    uint32_t dpBits;
+    uint32_t maxLength;
+    uint32_t tableIndex;
+
+    uint64_t mask() const { return (1ULL << bits) - 1; }
+
+    inline uint64_t step(uint64_t index) const {
+        return reduceToIndex(encryptUnderIndex(index, plaintext), tableIndex, mask());
+    }
+
+    inline bool distinguished(uint64_t index) const { return (index >> (bits - dpBits)) == 0; }
+
+    /// Walks from `index` to its distinguished point; false if none within maxLength steps.
+    inline bool walk(uint64_t index, uint64_t& end, uint64_t& length) const {
+        for (length = 0; length <= maxLength; ++length) {
+            if (distinguished(index)) {
+                end = index;
+                return true;
+            }
+            index = step(index);
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief Rank that owns a distinguished point.
+ */
+static inline int ownerOf(uint64_t end, int ranks) {
+    return static_cast<int>(mix64(end) % ranks);
+}
+
+/**
+ * @brief Returns the path of one shard.
+ */
+static std::string shardPath(const std::string& table, int shard, int shards) {
+    return table + "." + std::to_string(shard) + "of" + std::to_string(shards);
+}
+
+/**
+ * @brief Sends to every rank the records addressed to it. Collective over `comm`.
+ *
+ * @param outgoing Records for each rank, as `width` words per record.
+ * @return The records addressed to the calling rank.
+ */
+static std::vector<uint64_t> exchange(MPI_Comm comm, const std::vector<std::vector<uint64_t>>& outgoing) {
+    int numProcesses = outgoing.size();
+    std::vector<int> sendCounts(numProcesses), sendDispl(numProcesses), recvCounts(numProcesses),
+        recvDispl(numProcesses);
+    std::vector<uint64_t> sendBuffer;
+    for (int r = 0; r < numProcesses; ++r) {
+        sendDispl[r] = sendBuffer.size();
+        sendCounts[r] = outgoing[r].size();
+        sendBuffer.insert(sendBuffer.end(), outgoing[r].begin(), outgoing[r].end());
+    }
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, comm);
+    int total = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        recvDispl[r] = total;
+        total += recvCounts[r];
+    }
+    std::vector<uint64_t> incoming(total);
+    MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendDispl.data(), MPI_UINT64_T, incoming.data(),
+                  recvCounts.data(), recvDispl.data(), MPI_UINT64_T, comm);
+    return incoming;
+}
+
+/**
+ * @brief Builds the sharded table. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int build(MPI_Comm comm, const std::string& path, const DpSpec& spec, uint64_t chains) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    // Every rank walks its slice of the chains from pseudo-random starts
+    auto start = Clock::now();
+    uint64_t perRank = chains / numProcesses;
+    uint64_t first = perRank * processId;
+    uint64_t last = (processId == numProcesses - 1) ? chains : first + perRank;
+    std::vector<std::vector<uint64_t>> outgoing(numProcesses);
+    uint64_t dropped = 0, steps = 0;
+#pragma omp parallel reduction(+:dropped, steps)
+    {
+        std::vector<std::vector<uint64_t>> mine(numProcesses);
+#pragma omp for schedule(dynamic, 64) nowait
+        for (uint64_t g = first; g < last; ++g) {
+            uint64_t begin = mix64(static_cast<uint64_t>(spec.tableIndex) << 48 ^ g) & spec.mask();
+            uint64_t end, length;
+            if (!spec.walk(begin, end, length)) {
+                ++dropped;
+                continue;
+            }
+            steps += length;
+            std::vector<uint64_t>& out = mine[ownerOf(end, numProcesses)];
+            out.push_back(end);
+            out.push_back(begin);
+            out.push_back(length);
+        }
+#pragma omp critical
+        for (int r = 0; r < numProcesses; ++r) {
+            outgoing[r].insert(outgoing[r].end(), mine[r].begin(), mine[r].end());
+        }
+    }
+    double chainSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Each owner keeps the longest chain per distinguished point of its shard
+    std::vector<uint64_t> incoming = exchange(comm, outgoing);
+    std::vector<DpChain> shard(incoming.size() / 3);
+    memcpy(shard.data(), incoming.data(), shard.size() * sizeof(DpChain));
+    std::sort(shard.begin(), shard.end());
+    shard.erase(std::unique(shard.begin(), shard.end(),
+                            [](const DpChain& a, const DpChain& b) { return a.end == b.end; }),
+                shard.end());
+    uint64_t keptSteps = 0;
+    for (const DpChain& c : shard) {
+        keptSteps += c.length + 1;
+    }
+
+    DpHeader header = {};
+    memcpy(header.magic, kDpMagic, 8);
+    memcpy(header.plaintext, spec.plaintext, 8);
+    header.bits = spec.bits;
+    header.dpBits = spec.dpBits;
+    header.maxLength = spec.maxLength;
+    header.tableIndex = spec.tableIndex;
+    header.shard = processId;
+    header.shards = numProcesses;
+    header.count = shard.size();
+    std::string file = shardPath(path, processId, numProcesses);
+    std::ofstream out(file + ".tmp", std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(shard.data()), shard.size() * sizeof(DpChain));
+    out.close();
+    int ok = static_cast<bool>(out) && std::rename((file + ".tmp").c_str(), file.c_str()) == 0;
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+
+    uint64_t totals[4] = {shard.size(), dropped, steps, keptSteps};
+    MPI_Allreduce(MPI_IN_PLACE, totals, 4, MPI_UINT64_T, MPI_SUM, comm);
+    uint64_t largest = shard.size();
+    MPI_Allreduce(MPI_IN_PLACE, &largest, 1, MPI_UINT64_T, MPI_MAX, comm);
+    if (processId == 0) {
+        if (!ok) {
+            std::cerr << "Failed to write the shards of " << path << std::endl;
+            return 1;
+        }
+        double keyspace = static_cast<double>(1ULL << spec.bits);
+        std::cout << "DP table " << path << ": " << chains << " chains, " << totals[0] << " stored in "
+                  << numProcesses << " shards (largest " << largest << "), " << totals[1]
+                  << " dropped as too long, mean length "
+                  << static_cast<double>(totals[2]) / std::max<uint64_t>(chains - totals[1], 1)
+                  << std::endl;
+        std::cout << "Keys on stored chains: " << totals[3] << " (at most " << 100.0 * totals[3] / keyspace
+                  << "% of the " << spec.bits << "-bit key space)" << std::endl;
+        std::cout << "Chain generation: " << chainSeconds << " s" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
+
+/**
+ * @brief Looks ciphertext blocks up in the sharded table. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int lookup(MPI_Comm comm, const std::string& path, std::vector<std::string> queries) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    MappedTable<DpHeader, DpChain> table;
+    std::string error;
+    int ok = table.open(shardPath(path, processId, numProcesses), kDpMagic, error);
+    MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_LAND, comm);
+    if (!ok) {
+        if (!error.empty()) {
+            std::cerr << error << " (run the lookup on as many processes as the build)" << std::endl;
+        }
+        return 1;
+    }
+    const DpHeader& header = table.header();
+    DpSpec spec = {header.plaintext, header.bits, header.dpBits, header.maxLength, header.tableIndex};
+
+    // Process 0 broadcasts the ciphertext blocks
+    std::vector<uint64_t> targets;
+    int status = 0;
+    if (processId == 0) {
+        if (queries.empty()) {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                queries.push_back(line);
+            }
+        }
+        for (const std::string& query : queries) {
+            std::vector<unsigned char> bytes;
+            if (!decodeHex(query, bytes) || bytes.size() != 8) {
+                std::cerr << "Not an 8-byte hex block: " << query << std::endl;
+                status = 1;
+                continue;
+            }
+            targets.push_back(blockToWord(bytes.data()));
+        }
+    }
+    uint64_t numTargets = targets.size();
+    MPI_Bcast(&numTargets, 1, MPI_UINT64_T, 0, comm);
+    targets.resize(numTargets);
+    MPI_Bcast(targets.data(), numTargets, MPI_UINT64_T, 0, comm);
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Walk this rank's share of the targets to their distinguished points
+    std::vector<std::vector<uint64_t>> requests(numProcesses);
+#pragma omp parallel
+    {
+        std::vector<std::vector<uint64_t>> mine(numProcesses);
+#pragma omp for schedule(dynamic, 1) nowait
+        for (uint64_t q = processId; q < numTargets; q += numProcesses) {
+            uint64_t end, length;
+            if (spec.walk(reduceToIndex(targets[q], spec.tableIndex, spec.mask()), end, length)) {
+                std::vector<uint64_t>& out = mine[ownerOf(end, numProcesses)];
+                out.push_back(q);
+                out.push_back(end);
+            }
+        }
+#pragma omp critical
+        for (int r = 0; r < numProcesses; ++r) {
+            requests[r].insert(requests[r].end(), mine[r].begin(), mine[r].end());
+        }
+    }
+
+    // Resolve the requests against the local shard: the chain must go through the key
+    std::vector<uint64_t> incoming = exchange(comm, requests);
+    std::vector<uint64_t> results;  // {target, key} for every key found
+#pragma omp parallel
+    {
+        std::vector<uint64_t> mine;
+#pragma omp for schedule(dynamic, 1) nowait
+        for (size_t i = 0; i < incoming.size(); i += 2) {
+            uint64_t q = incoming[i];
+            DpChain probe = {incoming[i + 1], 0, UINT64_MAX};
+            const DpChain* hit = std::lower_bound(table.begin(), table.end(), probe);
+            if (hit == table.end() || hit->end != probe.end) {
+                continue;
+            }
+            uint64_t index = hit->start;
+            for (uint64_t s = 0; s <= hit->length; ++s) {
+                uint64_t block = encryptUnderIndex(index, spec.plaintext);
+                if (block == targets[q]) {
+                    mine.push_back(q);
+                    mine.push_back(index);
+                    break;
+                }
+                index = reduceToIndex(block, spec.tableIndex, spec.mask());
+            }
+        }
+#pragma omp critical
+        results.insert(results.end(), mine.begin(), mine.end());
+    }
+
+    // Process 0 collects and prints the keys
+    int resultWords = results.size();
+    std::vector<int> counts(numProcesses), displacements(numProcesses);
+    MPI_Gather(&resultWords, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+    int total = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        displacements[r] = total;
+        total += counts[r];
+    }
+    std::vector<uint64_t> all(processId == 0 ? total : 0);
+    MPI_Gatherv(results.data(), resultWords, MPI_UINT64_T, all.data(), counts.data(), displacements.data(),
+                MPI_UINT64_T, 0, comm);
+    if (processId == 0) {
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        std::vector<char> found(numTargets, 0);
+        std::vector<uint64_t> keys(numTargets, 0);
+        for (int i = 0; i < total; i += 2) {
+            found[all[i]] = 1;
+            keys[all[i]] = all[i + 1];
+        }
+        uint64_t solved = 0;
+        for (uint64_t q = 0; q < numTargets; ++q) {
+            unsigned char block[8];
+            wordToBlock(targets[q], block);
+            if (found[q]) {
+                unsigned char keyBytes[8];
+                indexToDesKey(keys[q], keyBytes);
+                std::cout << blockToHex(block) << ": key index " << keys[q] << " (key " << blockToHex(keyBytes) << ")"
+                          << std::endl;
+                ++solved;
+            } else {
+                std::cout << blockToHex(block) << ": not found" << std::endl;
+            }
+        }
+        std::cout << solved << " of " << numTargets << " found in " << seconds << " s" << std::endl;
+    }
+    return status;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  mpirun -np <n> " << program << " build <table> (--plaintext <text> | --plaintext-hex <hex>)\n"
+              << "      --bits <b> [--dp-bits <d>] [--chains <m>] [--max-length <l>] [--table-index <i>]"
+              << " [--threads <n>]\n"
+              << "  mpirun -np <n> " << program << " lookup <table> [--threads <n>] [<ciphertext block hex> ...]"
+              << "   (blocks on stdin if none)\n"
+              << "Defaults: --dp-bits bits/3 --chains 2^(bits - 2 dp-bits) --max-length 16 * 2^dp-bits"
+              << " --table-index 0 --threads 4" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::string command = argc > 2 ? argv[1] : "";
+    std::string plaintextArg;
+    std::vector<std::string> queries;
+    bool hex = false;
+    int bits = 0, dpBits = -1, threads = 4;
+    uint64_t chains = 0, maxLength = 0, tableIndex = 0;
+    bool valid = command == "build" || command == "lookup";
+    for (int i = 3; i < argc && valid; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            queries.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[++i];
+        if (arg == "--plaintext" || arg == "--plaintext-hex") {
+            plaintextArg = value;
+            hex = arg == "--plaintext-hex";
+        } else if (arg == "--bits") {
+            bits = std::atoi(value.c_str());
+        } else if (arg == "--dp-bits") {
+            dpBits = std::atoi(value.c_str());
+        } else if (arg == "--chains") {
+            chains = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--max-length") {
+            maxLength = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--table-index") {
+            tableIndex = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--threads") {
+            threads = std::atoi(value.c_str());
+        } else {
+            valid = false;
+        }
+    }
+    valid = valid && threads > 0;
+
+    int status = 1;
+    if (valid && command == "lookup") {
+        omp_set_num_threads(threads);
+        status = lookup(comm, argv[2], queries);
+    } else if (valid && command == "build") {
+        unsigned char plaintext[8];
+        if (dpBits < 0) {
+            dpBits = bits / 3;
+        }
+        valid = bits >= 2 && bits <= kDesKeyBits && dpBits >= 1 && dpBits < bits && tableIndex < (1ULL << 16) &&
+                queries.empty() && parseBlock(plaintextArg, hex, plaintext);
+        if (valid) {
+            // Hellman's matrix stopping rule: m * t^2 ~ N keeps merges from wasting most of the work
+            if (chains == 0) {
+                chains = 1ULL << std::max(bits - 2 * dpBits, 0);
+            }
+            if (maxLength == 0) {
+                maxLength = 16ULL << dpBits;
+            }
+            valid = maxLength <= UINT32_MAX;
+        }
+        if (valid) {
+            omp_set_num_threads(threads);
+            DpSpec spec = {plaintext, static_cast<uint32_t>(bits), static_cast<uint32_t>(dpBits),
+                           static_cast<uint32_t>(maxLength), static_cast<uint32_t>(tableIndex)};
+            status = build(comm, argv[2], spec, chains);
+        }
+    }
+    if (!valid && processId == 0) {
+        printUsage(argv[0]);
+    }
+
+    MPI_Finalize();
+    return status;
+}
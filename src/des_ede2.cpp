@@ -0,0 +1,365 @@
+/**
+ * @file des_ede2.cpp
+ * @brief Known-plaintext attacks on two-key triple DES (EDE2), C = E_K1(D_K2(E_K1(P))).
+ *
+ * Keys are key indices (des_keyspace.h). Two attacks are offered:
+ *
+ * - `search`: exhaustive search of the keys consistent with what is known about them.
+ *   Every key is given as a known index plus a mask of its unknown index bits; the
+ *   2^(u1 + u2) combinations are split over the ranks and their threads. The outer key
+ *   K1 changes slowest, so its schedule and E_K1(P1) are computed once per K1 and each
+ *   candidate costs one key schedule and two DES operations.
+ * - `vow`: the van Oorschot-Wiener known-plaintext attack. For an intermediate value A
+ *   (= E_K1(P) for some pair), every K1 gives P' = D_K1(A); if P' is one of the n known
+ *   plaintexts, B = D_K1(C) of that pair is stored with K1. Then every K2 with
+ *   D_K2(A) = B is a candidate (K1, K2), checked on the other pairs. One A costs 2 x 2^bits
+ *   operations and succeeds only if it is E_K1(P) for the true K1 and one of the n pairs,
+ *   i.e. with probability about n / 2^64 whatever the key width (n x 2^bits / 2^64 is the
+ *   expected size of the first table, not the chance of success). The attack tries many A
+ *   values (spread over the ranks), so a random `--a-start` range only pays off with
+ *   around 2^64 / n of them; for reduced-width tests the range must cover the A planted
+ *   with `encrypt --middle`. Both probes go through BlockHash tables, the structure the
+ *   multi-target searches use for their targets.
+ *
+ * Usage:
+ *
+ *     ./des_ede2 encrypt --plaintext-hex 4573746120657320 --k1 12345 --k2 54321   # prints P:C
+ *     mpirun -np 4 ./des_ede2 search --pair P1:C1 --pair P2:C2 --bits 16
+ *     mpirun -np 4 ./des_ede2 search --pair P1:C1 --k1 <index> --k1-unknown ff --k2-unknown ffff
+ *     mpirun -np 4 ./des_ede2 vow --pair P1:C1 --pair P2:C2 --bits 20 --a-start <hex> --a-count 64
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o des_ede2 des_ede2.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <cstring>
+#include <mpi.h>
+#include <omp.h>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "block_hash.h"
+#include "des_tables.h"
+
+/**
+ * @brief Encrypts a block with EDE2 under prepared key schedules.
+ */
+static inline uint64_t ede2Encrypt(DES_key_schedule& k1, DES_key_schedule& k2, uint64_t block) {
+    return cryptWord(k1, cryptWord(k2, cryptWord(k1, block, DES_ENCRYPT), DES_DECRYPT), DES_ENCRYPT);
+}
+
+/**
+ * @brief Checks a candidate key pair against the known pairs from `first` on.
+ */
+static bool checkPairs(uint64_t k1, uint64_t k2, const std::vector<KnownPair>& pairs, size_t first) {
+    DES_key_schedule s1, s2;
+    scheduleForIndex(k1, s1);
+    scheduleForIndex(k2, s2);
+    for (size_t p = first; p < pairs.size(); ++p) {
+        if (ede2Encrypt(s1, s2, blockToWord(pairs[p].plaintext)) != blockToWord(pairs[p].ciphertext)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Gathers the (K1, K2) pairs found by every process and prints each distinct one on process 0.
+ *
+ * The same key pair can be found more than once, e.g. by `vow` through every known pair
+ * whose plaintext reaches a tried A, on the same or on different processes.
+ */
+static void reportFound(MPI_Comm comm, const std::vector<uint64_t>& found) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    int sendCount = static_cast<int>(found.size());
+    std::vector<int> recvCounts(numProcesses), displs(numProcesses, 0);
+    MPI_Gather(&sendCount, 1, MPI_INT, recvCounts.data(), 1, MPI_INT, 0, comm);
+    int totalCount = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        displs[r] = totalCount;
+        totalCount += recvCounts[r];
+    }
+    std::vector<uint64_t> all(processId == 0 ? totalCount : 0);
+    MPI_Gatherv(found.data(), sendCount, MPI_UINT64_T, all.data(), recvCounts.data(), displs.data(),
+                MPI_UINT64_T, 0, comm);
+
+    if (processId == 0) {
+        std::vector<std::pair<uint64_t, uint64_t>> keys;
+        for (size_t i = 0; i < all.size(); i += 2) {
+            keys.emplace_back(all[i], all[i + 1]);
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for (const auto& key : keys) {
+            unsigned char k1[8], k2[8];
+            indexToDesKey(key.first, k1);
+            indexToDesKey(key.second, k2);
+            std::cout << "Found K1 index " << key.first << " (key " << blockToHex(k1) << "), K2 index " << key.second
+                      << " (key " << blockToHex(k2) << ")" << std::endl;
+        }
+        if (keys.empty()) {
+            std::cout << "No key pair found" << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Searches every key pair that agrees with the known key bits. Collective over `comm`.
+ *
+ * @param k1 Known bits of K1 (the bits in `k1Unknown` are ignored).
+ * @param k1Unknown Mask of the unknown index bits of K1.
+ * @return Process exit status.
+ */
+static int search(MPI_Comm comm, const std::vector<KnownPair>& pairs, uint64_t k1, uint64_t k1Unknown, uint64_t k2,
+                  uint64_t k2Unknown) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    auto start = Clock::now();
+    int k2Bits = __builtin_popcountll(k2Unknown);
+    uint64_t total = 1ULL << (__builtin_popcountll(k1Unknown) + k2Bits);
+    uint64_t perRank = total / numProcesses;
+    uint64_t sliceBegin = perRank * processId;
+    uint64_t sliceEnd = (processId == numProcesses - 1) ? total : sliceBegin + perRank;
+    uint64_t p1 = blockToWord(pairs[0].plaintext);
+    uint64_t c1 = blockToWord(pairs[0].ciphertext);
+
+    std::vector<uint64_t> found;
+    uint64_t candidates = 0, falsePositives = 0;
+#pragma omp parallel reduction(+ : candidates, falsePositives)
+    {
+        std::vector<uint64_t> local;
+        DES_key_schedule s1, s2;
+        uint64_t outer = UINT64_MAX, key1 = 0, middle = 0;
+#pragma omp for schedule(static)
+        for (uint64_t i = sliceBegin; i < sliceEnd; ++i) {
+            if (i >> k2Bits != outer) {
+                outer = i >> k2Bits;
+                key1 = (k1 & ~k1Unknown) | depositBits(outer, k1Unknown);
+                scheduleForIndex(key1, s1);
+                middle = cryptWord(s1, p1, DES_ENCRYPT);
+            }
+            uint64_t key2 = (k2 & ~k2Unknown) | depositBits(i & ((1ULL << k2Bits) - 1), k2Unknown);
+            scheduleForIndex(key2, s2);
+            if (cryptWord(s1, cryptWord(s2, middle, DES_DECRYPT), DES_ENCRYPT) != c1) {
+                continue;
+            }
+            ++candidates;
+            if (checkPairs(key1, key2, pairs, 1)) {
+                local.push_back(key1);
+                local.push_back(key2);
+            } else {
+                ++falsePositives;
+            }
+        }
+#pragma omp critical
+        found.insert(found.end(), local.begin(), local.end());
+    }
+
+    uint64_t counters[2] = {candidates, falsePositives};
+    MPI_Reduce(processId == 0 ? MPI_IN_PLACE : counters, counters, 2, MPI_UINT64_T, MPI_SUM, 0, comm);
+    reportFound(comm, found);
+    if (processId == 0) {
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << "Searched " << total << " key pairs in " << seconds << " s on " << numProcesses
+                  << " processes: " << counters[0] << " candidates, " << counters[1] << " rejected by the other "
+                  << pairs.size() - 1 << " pair(s)" << std::endl;
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the van Oorschot-Wiener attack over intermediate values
+ * [aStart, aStart + aCount), spread over the processes. Collective over `comm`.
+ *
+ * @param bits Both keys are searched in [0, 2^bits).
+ * @return Process exit status.
+ */
+static int vow(MPI_Comm comm, const std::vector<KnownPair>& pairs, int bits, uint64_t aStart, uint64_t aCount) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    auto start = Clock::now();
+    int64_t keyspace = 1LL << bits;
+    std::vector<uint64_t> plaintexts;
+    for (const KnownPair& pair : pairs) {
+        plaintexts.push_back(blockToWord(pair.plaintext));
+    }
+    BlockHash plaintextHash(plaintexts);
+
+    std::vector<uint64_t> found;
+    uint64_t entries = 0, candidates = 0, falsePositives = 0;
+    for (uint64_t n = processId; n < aCount; n += numProcesses) {
+        uint64_t a = aStart + n;
+
+        // Stage 1: the K1 that take some known plaintext to A, with B = D_K1(C) of that pair
+        std::vector<uint64_t> middles, outerKeys;
+#pragma omp parallel for schedule(static)
+        for (int64_t k1 = 0; k1 < keyspace; ++k1) {
+            DES_key_schedule s1;
+            scheduleForIndex(k1, s1);
+            uint64_t plaintext = cryptWord(s1, a, DES_DECRYPT);
+            for (uint32_t t = plaintextHash.find(plaintext); t != BlockHash::kNone; t = plaintextHash.next(t)) {
+                uint64_t b = cryptWord(s1, blockToWord(pairs[t].ciphertext), DES_DECRYPT);
+#pragma omp critical
+                {
+                    middles.push_back(b);
+                    outerKeys.push_back(k1);
+                }
+            }
+        }
+        entries += middles.size();
+        if (middles.empty()) {
+            continue;
+        }
+
+        // Stage 2: the K2 that decrypt A to a stored B
+        BlockHash middleHash(middles);
+#pragma omp parallel for schedule(static) reduction(+ : candidates, falsePositives)
+        for (int64_t k2 = 0; k2 < keyspace; ++k2) {
+            DES_key_schedule s2;
+            scheduleForIndex(k2, s2);
+            uint64_t b = cryptWord(s2, a, DES_DECRYPT);
+            for (uint32_t e = middleHash.find(b); e != BlockHash::kNone; e = middleHash.next(e)) {
+                ++candidates;
+                if (checkPairs(outerKeys[e], k2, pairs, 0)) {
+#pragma omp critical
+                    {
+                        found.push_back(outerKeys[e]);
+                        found.push_back(k2);
+                    }
+                } else {
+                    ++falsePositives;
+                }
+            }
+        }
+    }
+
+    uint64_t counters[3] = {entries, candidates, falsePositives};
+    MPI_Reduce(processId == 0 ? MPI_IN_PLACE : counters, counters, 3, MPI_UINT64_T, MPI_SUM, 0, comm);
+    reportFound(comm, found);
+    if (processId == 0) {
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << "Tried " << aCount << " intermediate values in " << seconds << " s on " << numProcesses
+                  << " processes: " << counters[0] << " table entries, " << counters[1] << " candidates, "
+                  << counters[2] << " rejected by the other pairs" << std::endl;
+    }
+    return 0;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  " << program << " encrypt (--plaintext <text> | --plaintext-hex <hex> | --middle <hex>)"
+              << " --k1 <index> --k2 <index>\n"
+              << "  mpirun -np <n> " << program << " search --pair <P hex>:<C hex> [--pair ...]"
+              << " [--bits <b>] [--k1 <index>] [--k1-unknown <hex mask>]\n"
+              << "      [--k2 <index>] [--k2-unknown <hex mask>] [--threads <n>]\n"
+              << "  mpirun -np <n> " << program << " vow --pair <P hex>:<C hex> --pair ... --bits <b>"
+              << " --a-start <hex> --a-count <n> [--threads <n>]\n"
+              << "`encrypt --middle A` picks the plaintext with E_K1(P) = A. `search --bits b` makes the low b"
+              << " index bits of both keys unknown.\n"
+              << "Defaults: --k1 0 --k2 0 --threads 4" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::string command = argc > 1 ? argv[1] : "";
+    std::string plaintextArg, middleArg;
+    std::vector<KnownPair> pairs;
+    bool hex = false;
+    int bits = 0, threads = 4;
+    uint64_t k1 = 0, k2 = 0, k1Unknown = 0, k2Unknown = 0, aStart = 0, aCount = 0;
+    bool valid = command == "encrypt" || command == "search" || command == "vow";
+    for (int i = 2; i < argc && valid; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[i + 1];
+        if (arg == "--pair") {
+            KnownPair pair;
+            valid = parsePair(value, pair);
+            pairs.push_back(pair);
+        } else if (arg == "--plaintext" || arg == "--plaintext-hex") {
+            plaintextArg = value;
+            hex = arg == "--plaintext-hex";
+        } else if (arg == "--middle") {
+            middleArg = value;
+        } else if (arg == "--bits") {
+            bits = std::atoi(value.c_str());
+        } else if (arg == "--k1") {
+            k1 = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--k2") {
+            k2 = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--k1-unknown") {
+            k1Unknown = std::strtoull(value.c_str(), nullptr, 16);
+        } else if (arg == "--k2-unknown") {
+            k2Unknown = std::strtoull(value.c_str(), nullptr, 16);
+        } else if (arg == "--a-start") {
+            aStart = std::strtoull(value.c_str(), nullptr, 16);
+        } else if (arg == "--a-count") {
+            aCount = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--threads") {
+            threads = std::atoi(value.c_str());
+        } else {
+            valid = false;
+        }
+    }
+    if (bits > 0 && bits <= kDesKeyBits && command == "search") {
+        k1Unknown |= (1ULL << bits) - 1;
+        k2Unknown |= (1ULL << bits) - 1;
+    }
+    uint64_t indexMask = (1ULL << kDesKeyBits) - 1;
+    valid = valid && threads > 0 && (k1 | k2 | k1Unknown | k2Unknown) <= indexMask;
+
+    int status = 1;
+    if (valid && command == "encrypt") {
+        unsigned char block[8];
+        DES_key_schedule s1, s2;
+        scheduleForIndex(k1, s1);
+        scheduleForIndex(k2, s2);
+        bool fromMiddle = !middleArg.empty();
+        if (fromMiddle ? parseBlock(middleArg, true, block) : parseBlock(plaintextArg, hex, block)) {
+            uint64_t plaintext = fromMiddle ? cryptWord(s1, blockToWord(block), DES_DECRYPT) : blockToWord(block);
+            if (processId == 0) {
+                unsigned char p[8], c[8];
+                wordToBlock(plaintext, p);
+                wordToBlock(ede2Encrypt(s1, s2, plaintext), c);
+                std::cout << blockToHex(p) << ":" << blockToHex(c) << std::endl;
+            }
+            status = 0;
+        } else if (processId == 0) {
+            printUsage(argv[0]);
+        }
+    } else if (valid && command == "search" && !pairs.empty() &&
+               __builtin_popcountll(k1Unknown) + __builtin_popcountll(k2Unknown) <= 62) {
+        omp_set_num_threads(threads);
+        status = search(comm, pairs, k1, k1Unknown, k2, k2Unknown);
+    } else if (valid && command == "vow" && pairs.size() >= 2 && bits >= 1 && bits <= 40 && aCount > 0) {
+        omp_set_num_threads(threads);
+        status = vow(comm, pairs, bits, aStart, aCount);
+    } else if (processId == 0) {
+        printUsage(argv[0]);
+    }
+
+    MPI_Finalize();
+    return status;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file des_keyspace.h
+ * @brief Enumeration of the distinct DES keys by a 56-bit index.
+ *
+ * A DES key is 8 bytes, but the low bit of every byte is a parity bit the cipher ignores,
+ * so consecutive integers (as used by the brute-force drivers) name the same key in pairs.
+ * The index below packs the 56 effective bits, 7 per byte, with the last byte holding the
+ * least significant ones: indices [0, 2^b) are exactly the 2^b distinct keys whose first
+ * 56 - b effective bits are zero, which is how reduced key spaces (40-bit export keys,
+ * 32-bit legacy keys, ...) are laid out.
+ *
+ * @date October 2024
+ */
+
+#ifndef DES_KEYSPACE_H
+#define DES_KEYSPACE_H
+
+#include <cstdint>
+
+/// Effective key bits of DES.
+static const int kDesKeyBits = 56;
+
+/**
+ * @brief Converts a key index in [0, 2^56) to the 8-byte DES key, with odd parity.
+ */
+static inline void indexToDesKey(uint64_t index, unsigned char key[8]) {
+    for (int i = 0; i < 8; ++i) {
+        unsigned char bits = static_cast<unsigned char>((index >> (7 * (7 - i))) & 0x7F) << 1;
+        key[i] = bits | (__builtin_parity(bits) ? 0 : 1);
+    }
+}
+
+/**
+ * @brief Converts an 8-byte DES key to its index; the parity bits are ignored.
+ */
+static inline uint64_t desKeyToIndex(const unsigned char key[8]) {
+    uint64_t index = 0;
+    for (int i = 0; i < 8; ++i) {
+        index = index << 7 | key[i] >> 1;
+    }
+    return index;
+}
+
+/**
+ * @brief Spreads the low bits of `value` over the set bits of `mask` (lowest first).
+ *
+ * Enumerates the keys that differ from a known key only in the bits of `mask`: key
+ * `known & ~mask | depositBits(i, mask)` for i in [0, 2^popcount(mask)).
+ */
+static inline uint64_t depositBits(uint64_t value, uint64_t mask) {
+    uint64_t result = 0;
+    for (; mask != 0; mask &= mask - 1, value >>= 1) {
+        if (value & 1) {
+            result |= mask & (~mask + 1);
+        }
+    }
+    return result;
+}
+
+#endif  // DES_KEYSPACE_H
@@ -0,0 +1,298 @@
+/**
+ * @file des_mitm.cpp
+ * @brief Meet-in-the-middle attack on double DES, C = E_K2(E_K1(P)), over reduced key spaces.
+ *
+ * Both keys are key indices in [0, 2^bits) (des_keyspace.h). Instead of trying all 2^(2 bits)
+ * key pairs, the attack meets in the middle:
+ *
+ * 1. The known plaintext P1 is encrypted under every K1 into a codebook E_K1(P1) -> K1,
+ *    sorted by the middle block (codebook.h: built on all ranks, bucket by bucket, with
+ *    an external merge sort of bounded runs). The table is kept and reused by later
+ *    searches with the same P1 and key size.
+ * 2. Every rank decrypts C1 under its slice of the K2 and looks the middle block
+ *    D_K2(C1) up in the memory-mapped codebook. Lookups run in batches of kBatch
+ *    interleaved branchless binary searches, so the cache misses of the independent
+ *    searches overlap instead of following each other.
+ * 3. A match is a candidate pair (K1, K2). With n-bit keys about 2^(2n - 64) wrong pairs
+ *    match one block by chance, so candidates are checked against the other known pairs
+ *    and the false positives are counted.
+ *
+ * Usage:
+ *
+ *     ./des_mitm encrypt --plaintext-hex 4573746120657320 --k1 12345 --k2 54321
+ *     mpirun -np 4 ./des_mitm search mitm24.cb --bits 24 --pair P1:C1 --pair P2:C2
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o des_mitm des_mitm.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <cstring>
+#include <mpi.h>
+#include <omp.h>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "codebook.h"
+
+/// Lookups interleaved per batch.
+static const int kBatch = 16;
+
+/**
+ * @brief Finds the lower bound of kBatch blocks in the sorted codebook records at once.
+ *
+ * Each search halves its range without branches (the comparison becomes a conditional
+ * move) and prefetches both records its next step may read; interleaving the kBatch
+ * independent searches keeps that many memory accesses in flight.
+ *
+ * @param records The sorted records (at least one).
+ * @param count The number of records.
+ * @param blocks The blocks to look up.
+ * @param found Set to the index of the first record not below each block.
+ */
+static inline void batchLowerBound(const CodebookRecord* records, uint64_t count, const uint64_t* blocks,
+                                   uint64_t* found) {
+    const CodebookRecord* base[kBatch];
+    for (int j = 0; j < kBatch; ++j) {
+        base[j] = records;
+    }
+    uint64_t length = count;
+    while (length > 1) {
+        uint64_t half = length / 2;
+        uint64_t next = (length - half) / 2;
+        for (int j = 0; j < kBatch; ++j) {
+            __builtin_prefetch(base[j] + next);
+            __builtin_prefetch(base[j] + half + next);
+        }
+        for (int j = 0; j < kBatch; ++j) {
+            base[j] = (base[j][half].block < blocks[j]) ? base[j] + half : base[j];
+        }
+        length -= half;
+    }
+    for (int j = 0; j < kBatch; ++j) {
+        found[j] = (base[j] - records) + (base[j]->block < blocks[j]);
+    }
+}
+
+/**
+ * @brief Checks a candidate key pair against the known pairs after the first.
+ */
+static bool checkPairs(uint64_t k1, uint64_t k2, const std::vector<KnownPair>& pairs) {
+    for (size_t p = 1; p < pairs.size(); ++p) {
+        unsigned char middle[8];
+        wordToBlock(encryptUnderIndex(k1, pairs[p].plaintext), middle);
+        if (encryptUnderIndex(k2, middle) != blockToWord(pairs[p].ciphertext)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Opens the codebook if it was built for this plaintext and key size.
+ */
+static bool openMatching(const std::string& path, const unsigned char* plaintext, int bits,
+                         MappedTable<CodebookHeader, CodebookRecord>& table) {
+    std::string error;
+    return table.open(path, kCodebookMagic, error) && memcmp(table.header().plaintext, plaintext, 8) == 0 &&
+           table.header().bits == static_cast<uint32_t>(bits);
+}
+
+/**
+ * @brief Runs the attack. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int search(MPI_Comm comm, const std::string& path, const std::vector<KnownPair>& pairs, int bits,
+                  uint64_t runKeys) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    // Reuse the codebook only if every rank sees a matching one
+    auto table = std::unique_ptr<MappedTable<CodebookHeader, CodebookRecord>>(
+        new MappedTable<CodebookHeader, CodebookRecord>());
+    int reuse = openMatching(path, pairs[0].plaintext, bits, *table);
+    MPI_Allreduce(MPI_IN_PLACE, &reuse, 1, MPI_INT, MPI_LAND, comm);
+    if (!reuse) {
+        table.reset(new MappedTable<CodebookHeader, CodebookRecord>());
+        CodebookStats stats;
+        std::string error;
+        if (!buildCodebook(comm, path, pairs[0].plaintext, bits, runKeys, stats, error)) {
+            if (processId == 0) {
+                std::cerr << error << std::endl;
+            }
+            return 1;
+        }
+        if (processId == 0) {
+            std::cout << "Codebook " << path << ": " << stats.count << " keys, built in "
+                      << stats.encryptSeconds + stats.mergeSeconds << " s" << std::endl;
+        }
+        if (!openMatching(path, pairs[0].plaintext, bits, *table)) {
+            std::cerr << "Process " << processId << " cannot map " << path << std::endl;
+            MPI_Abort(comm, 1);
+        }
+    } else if (processId == 0) {
+        std::cout << "Reusing codebook " << path << std::endl;
+    }
+
+    // Probe the middle blocks D_K2(C1) of this rank's slice of K2
+    auto searchStart = Clock::now();
+    uint64_t keyspace = 1ULL << bits;
+    uint64_t perRank = keyspace / numProcesses;
+    uint64_t sliceBegin = perRank * processId;
+    uint64_t sliceEnd = (processId == numProcesses - 1) ? keyspace : sliceBegin + perRank;
+    uint64_t batches = (sliceEnd - sliceBegin + kBatch - 1) / kBatch;
+    const CodebookRecord* records = table->begin();
+    uint64_t count = table->header().count;
+    const unsigned char* c1 = pairs[0].ciphertext;
+
+    uint64_t counters[2] = {0, 0};  // Candidates, false positives
+    std::vector<uint64_t> found;    // (K1, K2) pairs
+    uint64_t candidates = 0, falsePositives = 0;
+#pragma omp parallel reduction(+ : candidates, falsePositives)
+    {
+        std::vector<uint64_t> local;
+#pragma omp for schedule(static)
+        for (uint64_t b = 0; b < batches; ++b) {
+            uint64_t first = sliceBegin + b * kBatch;
+            uint64_t middles[kBatch], at[kBatch];
+            for (int j = 0; j < kBatch; ++j) {
+                // Pad the last batch by repeating its first key; the duplicates are skipped below
+                uint64_t k2 = first + j < sliceEnd ? first + j : first;
+                middles[j] = decryptUnderIndex(k2, c1);
+            }
+            batchLowerBound(records, count, middles, at);
+            for (int j = 0; j < kBatch && first + j < sliceEnd; ++j) {
+                for (uint64_t r = at[j]; r < count && records[r].block == middles[j]; ++r) {
+                    ++candidates;
+                    if (checkPairs(records[r].index, first + j, pairs)) {
+                        local.push_back(records[r].index);
+                        local.push_back(first + j);
+                    } else {
+                        ++falsePositives;
+                    }
+                }
+            }
+        }
+#pragma omp critical
+        found.insert(found.end(), local.begin(), local.end());
+    }
+    counters[0] = candidates;
+    counters[1] = falsePositives;
+    MPI_Reduce(processId == 0 ? MPI_IN_PLACE : counters, counters, 2, MPI_UINT64_T, MPI_SUM, 0, comm);
+
+    int sendCount = static_cast<int>(found.size());
+    std::vector<int> recvCounts(numProcesses), displs(numProcesses, 0);
+    MPI_Gather(&sendCount, 1, MPI_INT, recvCounts.data(), 1, MPI_INT, 0, comm);
+    int totalCount = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        displs[r] = totalCount;
+        totalCount += recvCounts[r];
+    }
+    std::vector<uint64_t> all(processId == 0 ? totalCount : 0);
+    MPI_Gatherv(found.data(), sendCount, MPI_UINT64_T, all.data(), recvCounts.data(), displs.data(),
+                MPI_UINT64_T, 0, comm);
+
+    if (processId == 0) {
+        double seconds = std::chrono::duration<double>(Clock::now() - searchStart).count();
+        for (size_t i = 0; i < all.size(); i += 2) {
+            unsigned char k1[8], k2[8];
+            indexToDesKey(all[i], k1);
+            indexToDesKey(all[i + 1], k2);
+            std::cout << "Found K1 index " << all[i] << " (key " << blockToHex(k1) << "), K2 index " << all[i + 1]
+                      << " (key " << blockToHex(k2) << ")" << std::endl;
+        }
+        if (all.empty()) {
+            std::cout << "No key pair found" << std::endl;
+        }
+        std::cout << "Searched " << keyspace << " K2 in " << seconds << " s on " << numProcesses << " processes: "
+                  << counters[0] << " candidates, " << counters[1] << " rejected by the other "
+                  << pairs.size() - 1 << " pair(s)" << std::endl;
+    }
+    return 0;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  mpirun -np <n> " << program << " search <table> --bits <b> --pair <P hex>:<C hex>"
+              << " [--pair <P hex>:<C hex> ...]\n"
+              << "      [--threads <n>] [--run-keys <n>]\n"
+              << "  " << program << " encrypt (--plaintext <text> | --plaintext-hex <hex>) --k1 <index> --k2 <index>\n"
+              << "The table is built for the first pair unless it already holds it; the other pairs filter"
+              << " the candidates.\n"
+              << "Defaults: --threads 4 --run-keys 16777216" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::string command = argc > 1 ? argv[1] : "";
+    int first = command == "search" ? 3 : 2;
+    std::string plaintextArg;
+    std::vector<KnownPair> pairs;
+    bool hex = false;
+    int bits = 0, threads = 4;
+    uint64_t runKeys = 1ULL << 24, k1 = 0, k2 = 0;
+    bool valid = (command == "search" && argc > 2) || command == "encrypt";
+    for (int i = first; i < argc && valid; i += 2) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[i + 1];
+        if (arg == "--pair") {
+            KnownPair pair;
+            valid = parsePair(value, pair);
+            pairs.push_back(pair);
+        } else if (arg == "--plaintext" || arg == "--plaintext-hex") {
+            plaintextArg = value;
+            hex = arg == "--plaintext-hex";
+        } else if (arg == "--bits") {
+            bits = std::atoi(value.c_str());
+        } else if (arg == "--threads") {
+            threads = std::atoi(value.c_str());
+        } else if (arg == "--run-keys") {
+            runKeys = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--k1") {
+            k1 = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--k2") {
+            k2 = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            valid = false;
+        }
+    }
+
+    int status = 1;
+    if (valid && command == "encrypt") {
+        unsigned char plaintext[8], middle[8], ciphertext[8];
+        if (k1 >> kDesKeyBits == 0 && k2 >> kDesKeyBits == 0 && parseBlock(plaintextArg, hex, plaintext)) {
+            if (processId == 0) {
+                wordToBlock(encryptUnderIndex(k1, plaintext), middle);
+                wordToBlock(encryptUnderIndex(k2, middle), ciphertext);
+                std::cout << blockToHex(plaintext) << ":" << blockToHex(ciphertext) << std::endl;
+            }
+            status = 0;
+        } else if (processId == 0) {
+            printUsage(argv[0]);
+        }
+    } else if (valid && bits >= 1 && bits <= kDesKeyBits && threads > 0 && runKeys > 0 && !pairs.empty()) {
+        omp_set_num_threads(threads);
+        status = search(comm, argv[2], pairs, bits, runKeys);
+    } else if (processId == 0) {
+        printUsage(argv[0]);
+    }
+
+    MPI_Finalize();
+    return status;
+}
@@ -0,0 +1,363 @@
+/**
+ * @file des_rainbow.cpp
+ * @brief Rainbow tables (Hellman time-memory trade-off) for DES under a fixed known plaintext.
+ *
+ * A chain starts at a key index k_0 and alternates encryption of the known block P with a
+ * column-specific reduction back to a key index (des_tables.h):
+ *
+ *     k_{i+1} = R_i(E_{k_i}(P)),  i = 0 .. t - 1
+ *
+ * Only (k_t, k_0) is stored. Given a ciphertext C = E_k(P), a lookup assumes C was produced
+ * in column j, walks R_j(C) to the end of the chain and looks the end point up; a hit is
+ * confirmed by regenerating the chain from its start (chains can merge, so a hit may be a
+ * false alarm). The t columns are independent and are walked in parallel by the threads.
+ *
+ * m chains of length t cover about m * t keys at a memory cost of m records, at the price
+ * of t^2 / 2 encryptions per lookup. Chains are generated in parallel over the MPI ranks;
+ * process 0 gathers the end points, drops chains that merged into the same end point and
+ * writes the table sorted by end point. The key space is [0, 2^bits) in key indices (see
+ * des_keyspace.h), so the trade-off can be tested on a 24- or 32-bit subspace first:
+ *
+ *     mpirun -np 4 ./des_rainbow build rt24 --plaintext 'Esta es ' --bits 24 --length 256
+ *     ./des_rainbow lookup rt24 0123456789abcdef ...   # or one block per line on stdin
+ *
+ * Several tables with different `--table-index` values use different reduction functions;
+ * together they raise the success rate (look a block up in each of them).
+ *
+ * @note Compile using Open MPI, OpenMP and OpenSSL:
+ * mpic++ -fopenmp -O3 -march=native -o des_rainbow des_rainbow.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <mpi.h>
+#include <omp.h>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "des_tables.h"
+
+/// Identifies a rainbow table file (and its layout version).
+static const char kRainbowMagic[8] = {'D', 'E', 'S', 'R', 'B', 'W', '0', '1'};
+
+/**
+ * @brief Header at the start of a rainbow table file; the chains follow it.
+ */
+struct RainbowHeader {
+    char magic[8];                ///< kRainbowMagic.
+    unsigned char plaintext[8];   ///< The known plaintext block.
+    uint32_t bits;                ///< Key indices [0, 2^bits) are covered.
+    uint32_t length;              ///< Chain length t.
+    uint32_t tableIndex;          ///< Selects the reduction functions.
+    uint32_t reserved;
+    uint64_t count;               ///< Number of chains stored.
+};
+
+/**
+ * @brief One stored chain, sorted by end point.
+ */
+struct RainbowChain {
+    uint64_t end;     ///< k_t.
+    uint64_t start;   ///< k_0.
+
+    bool operator<(const RainbowChain& other) const { return end < other.end; }
+};
+
+/**
+ * @brief The chain function of one table.
+ */
+struct RainbowSpec {
+    const unsigned char* plaintext;
+    uint64_t mask;          ///< 2^bits - 1.
+    uint32_t length;        ///< t.
+    uint32_t tableIndex;
+
+    /// One step: the key index of column `column + 1` from that of column `column`.
+    inline uint64_t step(uint64_t index, uint32_t column) const {
+        return reduceToIndex(encryptUnderIndex(index, plaintext), static_cast<uint64_t>(tableIndex) << 32 | column,
+                             mask);
+    }
+
+    /// Walks from `index` in column `from` to the end of the chain.
+    inline uint64_t walk(uint64_t index, uint32_t from) const {
+        for (uint32_t i = from; i < length; ++i) {
+            index = step(index, i);
+        }
+        return index;
+    }
+};
+
+/**
+ * @brief Expected fraction of the key space the chains walk through, from the number of chains
+ * generated. Merged chains are counted as they were generated, so this is an upper bound
+ * on what the stored table finds.
+ */
+static double rainbowCoverage(double keyspace, double chains, uint32_t length) {
+    double missed = 1.0;
+    double distinct = chains;
+    for (uint32_t i = 0; i < length; ++i) {
+        missed *= 1.0 - distinct / keyspace;
+        distinct = keyspace * (1.0 - std::exp(-distinct / keyspace));
+    }
+    return 1.0 - missed;
+}
+
+/**
+ * @brief Expected success rate of a lookup in a table of `endPoints` distinct chains of
+ * length t: 1 - exp(-m_t t / N). Each stored chain has its own end point, so the last
+ * column alone holds m_t distinct keys and every column at most as many.
+ */
+static double rainbowSuccess(double keyspace, double endPoints, uint32_t length) {
+    return 1.0 - std::exp(-endPoints * length / keyspace);
+}
+
+/**
+ * @brief Builds a rainbow table. Collective over `comm`.
+ *
+ * @return Process exit status.
+ */
+static int build(MPI_Comm comm, const std::string& path, const RainbowSpec& spec, uint64_t chains) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    // Chain g starts at key index g; every rank generates a contiguous slice of the chains
+    auto start = Clock::now();
+    uint64_t perRank = chains / numProcesses;
+    uint64_t first = perRank * processId;
+    uint64_t last = (processId == numProcesses - 1) ? chains : first + perRank;
+    std::vector<RainbowChain> local(last - first);
+#pragma omp parallel for schedule(dynamic, 256)
+    for (uint64_t g = first; g < last; ++g) {
+        local[g - first].start = g;
+        local[g - first].end = spec.walk(g, 0);
+    }
+    std::sort(local.begin(), local.end());
+    local.erase(std::unique(local.begin(), local.end(),
+                            [](const RainbowChain& a, const RainbowChain& b) { return a.end == b.end; }),
+                local.end());
+    double chainSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Process 0 gathers the sorted end points of every rank
+    int localBytes = local.size() * sizeof(RainbowChain);
+    std::vector<int> bytes(numProcesses), displacements(numProcesses);
+    MPI_Gather(&localBytes, 1, MPI_INT, bytes.data(), 1, MPI_INT, 0, comm);
+    size_t totalBytes = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        displacements[r] = totalBytes;
+        totalBytes += bytes[r];
+    }
+    std::vector<RainbowChain> all(processId == 0 ? totalBytes / sizeof(RainbowChain) : 0);
+    MPI_Gatherv(local.data(), localBytes, MPI_BYTE, all.data(), bytes.data(), displacements.data(), MPI_BYTE, 0, comm);
+    if (processId != 0) {
+        return 0;
+    }
+
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end(),
+                          [](const RainbowChain& a, const RainbowChain& b) { return a.end == b.end; }),
+              all.end());
+
+    RainbowHeader header = {};
+    memcpy(header.magic, kRainbowMagic, 8);
+    memcpy(header.plaintext, spec.plaintext, 8);
+    header.bits = __builtin_popcountll(spec.mask);
+    header.length = spec.length;
+    header.tableIndex = spec.tableIndex;
+    header.count = all.size();
+    std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(all.data()), all.size() * sizeof(RainbowChain));
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return 1;
+    }
+
+    double keyspace = std::ldexp(1.0, header.bits);
+    std::cout << "Rainbow table " << path << ": " << chains << " chains of length " << spec.length << ", "
+              << all.size() << " distinct end points, " << all.size() * sizeof(RainbowChain) / 1048576.0 << " MiB"
+              << std::endl;
+    std::cout << "Expected lookup success over the " << header.bits << "-bit key space: "
+              << 100.0 * rainbowSuccess(keyspace, all.size(), spec.length) << "% (from the distinct end points; "
+              << 100.0 * rainbowCoverage(keyspace, chains, spec.length) << "% walked by all " << chains
+              << " chains before merges)" << std::endl;
+    std::cout << "Chain generation: " << chainSeconds << " s on " << numProcesses << " processes" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief Looks ciphertext blocks up in a rainbow table.
+ *
+ * @return Process exit status.
+ */
+static int lookup(const std::string& path, std::vector<std::string> queries) {
+    MappedTable<RainbowHeader, RainbowChain> table;
+    std::string error;
+    if (!table.open(path, kRainbowMagic, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    const RainbowHeader& header = table.header();
+    RainbowSpec spec = {header.plaintext, (1ULL << header.bits) - 1, header.length, header.tableIndex};
+
+    if (queries.empty()) {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            queries.push_back(line);
+        }
+    }
+    int status = 0;
+    for (const std::string& query : queries) {
+        std::vector<unsigned char> bytes;
+        if (!decodeHex(query, bytes) || bytes.size() != 8) {
+            std::cerr << "Not an 8-byte hex block: " << query << std::endl;
+            status = 1;
+            continue;
+        }
+        uint64_t target = blockToWord(bytes.data());
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // Try every column, cheapest (last) first; each thread walks its own columns.
+        // `found` is read by all threads while one sets it, so both sides are atomic.
+        bool found = false;
+        uint64_t key = 0;
+        uint64_t falseAlarms = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:falseAlarms)
+        for (int64_t j = spec.length - 1; j >= 0; --j) {
+            bool done;
+#pragma omp atomic read
+            done = found;
+            if (done) {
+                continue;
+            }
+            uint32_t column = static_cast<uint32_t>(j);
+            uint64_t end = spec.walk(reduceToIndex(target, static_cast<uint64_t>(spec.tableIndex) << 32 | column,
+                                                   spec.mask),
+                                     column + 1);
+            RainbowChain probe = {end, 0};
+            const RainbowChain* hit = std::lower_bound(table.begin(), table.end(), probe);
+            if (hit == table.end() || hit->end != end) {
+                continue;
+            }
+            // Regenerate the chain up to column j and check that it really produces the target
+            uint64_t candidate = hit->start;
+            for (uint32_t i = 0; i < column; ++i) {
+                candidate = spec.step(candidate, i);
+            }
+            if (encryptUnderIndex(candidate, spec.plaintext) != target) {
+                ++falseAlarms;
+                continue;
+            }
+#pragma omp critical
+            {
+                if (!found) {
+                    key = candidate;
+#pragma omp atomic write
+                    found = true;
+                }
+            }
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        std::string hex = blockToHex(bytes.data());
+        if (found) {
+            unsigned char keyBytes[8];
+            indexToDesKey(key, keyBytes);
+            std::cout << hex << ": key index " << key << " (key " << blockToHex(keyBytes) << ")";
+        } else {
+            std::cout << hex << ": not found";
+        }
+        std::cout << ", " << falseAlarms << " false alarms, " << seconds << " s" << std::endl;
+    }
+    return status;
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  mpirun -np <n> " << program << " build <table> (--plaintext <text> | --plaintext-hex <hex>)\n"
+              << "      --bits <b> [--length <t>] [--chains <m>] [--table-index <i>] [--threads <n>]\n"
+              << "  " << program << " lookup <table> [--threads <n>] [<ciphertext block hex> ...]"
+              << "   (blocks on stdin if none)\n"
+              << "Defaults: --length 1024 --chains 2^bits / length --table-index 0 --threads 4" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm comm = MPI_COMM_WORLD;
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::string command = argc > 2 ? argv[1] : "";
+    std::string plaintextArg;
+    std::vector<std::string> queries;
+    bool hex = false;
+    int bits = 0, threads = 4;
+    uint64_t length = 1024, chains = 0, tableIndex = 0;
+    bool valid = command == "build" || command == "lookup";
+    for (int i = 3; i < argc && valid; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            queries.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[++i];
+        if (arg == "--plaintext" || arg == "--plaintext-hex") {
+            plaintextArg = value;
+            hex = arg == "--plaintext-hex";
+        } else if (arg == "--bits") {
+            bits = std::atoi(value.c_str());
+        } else if (arg == "--length") {
+            length = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--chains") {
+            chains = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--table-index") {
+            tableIndex = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--threads") {
+            threads = std::atoi(value.c_str());
+        } else {
+            valid = false;
+        }
+    }
+    valid = valid && threads > 0;
+
+    int status = 1;
+    if (valid && command == "lookup") {
+        omp_set_num_threads(threads);
+        if (processId == 0) {
+            status = lookup(argv[2], queries);
+        }
+    } else if (valid && command == "build") {
+        unsigned char plaintext[8];
+        if (chains == 0 && bits >= 1 && bits <= kDesKeyBits && length > 0) {
+            chains = std::max<uint64_t>((1ULL << bits) / length, 1);
+        }
+        valid = bits >= 1 && bits <= kDesKeyBits && length > 0 && length <= UINT32_MAX && chains > 0 &&
+                chains <= (1ULL << bits) && tableIndex <= UINT32_MAX && queries.empty() &&
+                parseBlock(plaintextArg, hex, plaintext);
+        if (valid) {
+            omp_set_num_threads(threads);
+            RainbowSpec spec = {plaintext, (1ULL << bits) - 1, static_cast<uint32_t>(length),
+                                static_cast<uint32_t>(tableIndex)};
+            status = build(comm, argv[2], spec, chains);
+        }
+    }
+    if (!valid && processId == 0) {
+        printUsage(argv[0]);
+    }
+
+    MPI_Finalize();
+    return status;
+}
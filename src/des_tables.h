@@ -0,0 +1,251 @@
+/**
+ * @file des_tables.h
+ * @brief Shared pieces of the precomputed-table tools: encryption by key index, block words
+ * and memory-mapped table files.
+ *
+ * The table tools (des_codebook, des_rainbow, ...) work on one known plaintext block P and
+ * on key indices (des_keyspace.h); the trade-off tables walk chains key -> E_key(P) ->
+ * reduced key -> ... They handle cipher blocks as 64-bit words read
+ * big-endian, so that the numeric order of the words is the byte order of the blocks.
+ *
+ * @date October 2024
+ */
+
+#ifndef DES_TABLES_H
+#define DES_TABLES_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <openssl/des.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ciphertext_io.h"
+#include "des_keyspace.h"
+
+/**
+ * @brief Reads an 8-byte block as a big-endian integer.
+ */
+static inline uint64_t blockToWord(const unsigned char* bytes) {
+    uint64_t word = 0;
+    for (int i = 0; i < 8; ++i) {
+        word = word << 8 | bytes[i];
+    }
+    return word;
+}
+
+/**
+ * @brief Writes a word as an 8-byte big-endian block.
+ */
+static inline void wordToBlock(uint64_t word, unsigned char* bytes) {
+    for (int i = 7; i >= 0; --i) {
+        bytes[i] = word & 0xFF;
+        word >>= 8;
+    }
+}
+
+/**
+ * @brief Returns a block as 16 lowercase hex digits.
+ */
+static inline std::string blockToHex(const unsigned char* bytes) {
+    std::string hex = encodeHex(bytes, 8);
+    hex.pop_back();  // Trailing newline
+    return hex;
+}
+
+/**
+ * @brief Encrypts the plaintext block under the key with the given index.
+ *
+ * @return The ciphertext block, as a word.
+ */
+static inline uint64_t encryptUnderIndex(uint64_t index, const unsigned char* plaintext) {
+    DES_cblock keyBlock;
+    DES_key_schedule schedule;
+    unsigned char ciphertext[8];
+    indexToDesKey(index, keyBlock);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+    DES_set_key_unchecked(&keyBlock, &schedule);
+    DES_ecb_encrypt((const_DES_cblock*)plaintext, (DES_cblock*)ciphertext, &schedule, DES_ENCRYPT);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+    return blockToWord(ciphertext);
+}
+
+/**
+ * @brief Decrypts the ciphertext block under the key with the given index.
+ *
+ * @return The plaintext block, as a word.
+ */
+static inline uint64_t decryptUnderIndex(uint64_t index, const unsigned char* ciphertext) {
+    DES_cblock keyBlock;
+    DES_key_schedule schedule;
+    unsigned char plaintext[8];
+    indexToDesKey(index, keyBlock);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+    DES_set_key_unchecked(&keyBlock, &schedule);
+    DES_ecb_encrypt((const_DES_cblock*)ciphertext, (DES_cblock*)plaintext, &schedule, DES_DECRYPT);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+    return blockToWord(plaintext);
+}
+
+/**
+ * @brief Prepares the key schedule of the key with the given index.
+ */
+static inline void scheduleForIndex(uint64_t index, DES_key_schedule& schedule) {
+    DES_cblock keyBlock;
+    indexToDesKey(index, keyBlock);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+    DES_set_key_unchecked(&keyBlock, &schedule);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+}
+
+/**
+ * @brief Encrypts or decrypts one block, given as a word, under a prepared key schedule.
+ *
+ * Lets a search reuse a schedule across many blocks (e.g. the outer key of 3DES).
+ */
+static inline uint64_t cryptWord(DES_key_schedule& schedule, uint64_t word, int direction) {
+    unsigned char in[8], out[8];
+    wordToBlock(word, in);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+    DES_ecb_encrypt((const_DES_cblock*)in, (DES_cblock*)out, &schedule, direction);
+
+#pragma GCC diagnostic pop  // Restore the previous warning settings
+    return blockToWord(out);
+}
+
+/**
+ * @brief Scrambles a 64-bit value (the splitmix64 finalizer).
+ */
+static inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Reduction function of the time-memory trade-off tables: maps a cipher block back
+ * to a key index in [0, mask].
+ *
+ * Every salt (e.g. table and column of a rainbow table) gives a different function: the
+ * block is XORed with a scrambled salt and truncated to the key space.
+ */
+static inline uint64_t reduceToIndex(uint64_t block, uint64_t salt, uint64_t mask) {
+    return (block ^ mix64(salt)) & mask;
+}
+
+/**
+ * @brief Parses a block given as text (up to 8 bytes, zero-padded) or as 16 hex digits.
+ *
+ * @return true If the block is well-formed.
+ */
+static inline bool parseBlock(const std::string& text, bool hex, unsigned char block[8]) {
+    memset(block, 0, 8);
+    if (hex) {
+        std::vector<unsigned char> bytes;
+        if (!decodeHex(text, bytes) || bytes.size() != 8) {
+            return false;
+        }
+        memcpy(block, bytes.data(), 8);
+        return true;
+    }
+    if (text.size() > 8) {
+        return false;
+    }
+    memcpy(block, text.data(), text.size());
+    return true;
+}
+
+/**
+ * @brief A known plaintext/ciphertext pair of blocks.
+ */
+struct KnownPair {
+    unsigned char plaintext[8];
+    unsigned char ciphertext[8];
+};
+
+/**
+ * @brief Parses a pair given as `<plaintext hex>:<ciphertext hex>`.
+ *
+ * @return true If the pair is well-formed.
+ */
+static inline bool parsePair(const std::string& text, KnownPair& pair) {
+    size_t colon = text.find(':');
+    return colon != std::string::npos && parseBlock(text.substr(0, colon), true, pair.plaintext) &&
+           parseBlock(text.substr(colon + 1), true, pair.ciphertext);
+}
+
+/**
+ * @brief A table file mapped read-only: a Header (with `magic` and `count` fields) followed
+ * by `count` records.
+ */
+template <typename Header, typename Record>
+class MappedTable {
+public:
+    MappedTable() : mapped(MAP_FAILED), size(0) {}
+
+    ~MappedTable() {
+        if (mapped != MAP_FAILED) {
+            munmap(mapped, size);
+        }
+    }
+
+    /**
+     * @brief Maps the file and checks its magic and that its size matches its record count.
+     *
+     * @param error Set to a description of the problem on failure.
+     * @return true If the table was mapped.
+     */
+    bool open(const std::string& path, const char* magic, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+            error = "Cannot open table " + path;
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+        size = st.st_size;
+        mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            error = "Cannot map table " + path;
+            return false;
+        }
+        if (memcmp(header().magic, magic, 8) != 0 ||
+            sizeof(Header) + header().count * sizeof(Record) != size) {
+            error = path + " is not a table of this kind";
+            return false;
+        }
+        return true;
+    }
+
+    const Header& header() const { return *static_cast<const Header*>(mapped); }
+    const Record* begin() const { return reinterpret_cast<const Record*>(static_cast<const Header*>(mapped) + 1); }
+    const Record* end() const { return begin() + header().count; }
+
+private:
+    void* mapped;
+    size_t size;
+};
+
+#endif  // DES_TABLES_H
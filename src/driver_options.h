@@ -0,0 +1,257 @@
+/**
+ * @file driver_options.h
+ * @brief Command-line parsing shared by the MPI brute-force drivers.
+ *
+ * The drivers take three positional arguments followed by optional flags:
+ *
+ *     <input_file> <encryption_key> <search_phrase_file> [options]
+ *
+ * With a ciphertext input format the input file holds the ciphertext and the key
+ * argument is not used (pass `-`). Further ciphertexts under the same key can be given with
+ * `--pair` to reject the keys that only match the phrase by chance.
+ *
+ * @date October 2024
+ */
+
+#ifndef DRIVER_OPTIONS_H
+#define DRIVER_OPTIONS_H
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ciphertext_io.h"
+#include "corpus.h"
+#include "coverage.h"
+
+/**
+ * @brief A further ciphertext under the key of the input (--pair), in the input's format and mode.
+ */
+struct ExtraPair {
+    std::string cipherFile;  ///< The ciphertext.
+    std::string phraseFile;  ///< File holding the phrase its plaintext contains.
+    long cribOffset = -1;    ///< Offset of the phrase in the plaintext; -1 when unknown.
+};
+
+/**
+ * @brief Options accepted by the MPI drivers.
+ */
+struct DriverOptions {
+    std::string inputFile;         ///< Plaintext or ciphertext input file.
+    std::string encryptionKey;     ///< Encryption key, as given on the command line ("-" when unknown).
+    std::string searchPhraseFile;  ///< File holding the search phrase.
+    std::string traceFile;         ///< Chrome trace output (--trace); empty when disabled.
+    int metricsPort = 0;           ///< Localhost TCP port of the metrics endpoint (--metrics-port).
+    std::string metricsSocket;     ///< Unix socket of the metrics endpoint (--metrics-socket).
+    int threads = 4;               ///< OpenMP threads per rank (--threads).
+    double deadlineSeconds = 0;    ///< Stop the search this many seconds after it starts (--deadline); 0 for none.
+    KeyPrior prior = PRIOR_UNIFORM;  ///< Order in which the key space is searched (--prior).
+    std::string checkpointFile;    ///< Checkpoint to resume from and to write at exit (--checkpoint).
+    CipherFormat inputFormat = FORMAT_PLAIN;  ///< Format of the input file (--input-format).
+    long cribOffset = -1;          ///< Offset of the phrase in the plaintext (--crib-offset); -1 when unknown.
+    std::string dumpCiphertext;    ///< Write the generated ciphertext here (--dump-ciphertext).
+    std::string corpus;            ///< Directory or manifest of ciphertexts to search (--corpus).
+    CorpusMode corpusMode = CORPUS_JOBS;  ///< How the corpus is searched (--corpus-mode).
+    std::string cacheDir;          ///< Directory of the solved-ciphertext cache (--cache); empty when disabled.
+    Engine engine = ENGINE_DES_ECB;  ///< Cipher and mode of the data (--mode).
+    unsigned char iv[8] = {};      ///< CBC initialization vector (--iv); zero when not given.
+    std::vector<ExtraPair> pairs;  ///< Further ciphertexts under the same key (--pair).
+
+    /// The IV to build CBC jobs with, or nullptr in ECB mode.
+    const unsigned char* cbcIv() const { return engine == ENGINE_DES_CBC ? iv : nullptr; }
+};
+
+/**
+ * @brief Prints the usage message of a driver to standard error.
+ *
+ * @param program The program name (argv[0]).
+ */
+static inline void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <input_file> <encryption_key> <search_phrase_file> [options]\n"
+              << "Options:\n"
+              << "  --trace <file>            Write a Chrome trace of the search timeline to <file>\n"
+              << "  --metrics-port <port>     Serve live metrics over HTTP on 127.0.0.1:<port>\n"
+              << "  --metrics-socket <path>   Serve live metrics over HTTP on the Unix socket <path>\n"
+              << "  --threads <n>             OpenMP threads per rank (default 4)\n"
+              << "  --deadline <seconds>      Stop the search cleanly after <seconds>\n"
+              << "  --prior <uniform|low-first>  Search order of the key space (default uniform)\n"
+              << "  --checkpoint <file>       Resume from <file> if it exists and write progress to it at exit\n"
+              << "  --input-format <plain|raw|hex|base64>  Format of <input_file> (default plain)\n"
+              << "  --crib-offset <n>         Byte offset of the search phrase in the plaintext (ciphertext input)\n"
+              << "  --dump-ciphertext <file>  Write the ciphertext of a plain input to <file> (.hex, .b64 or raw)\n"
+              << "  --corpus <dir|manifest>   Search every ciphertext of a corpus (<input_file> is not used)\n"
+              << "  --corpus-mode <jobs|sweep>  One job per ciphertext, or one multi-target sweep (default jobs)\n"
+              << "  --cache <dir>             Answer repeated jobs from, and record results in, the cache in <dir>\n"
+              << "  --mode <ecb|cbc|rc4-40>   DES in ECB or CBC mode, or 40-bit RC4 (default ecb)\n"
+              << "  --iv <hex>                CBC initialization vector, 16 hex digits (default zero)\n"
+              << "  --pair <file>:<phrase file>[:<crib offset>]  Another ciphertext under the same key, in the"
+              << " input format; keys must match every pair (repeatable)"
+              << std::endl;
+}
+
+/**
+ * @brief Parses the command line of a driver.
+ *
+ * @param argc Argument count.
+ * @param argv Argument vector.
+ * @param opts The options to fill.
+ * @param error Set to a description of the problem when parsing fails.
+ * @return true If the command line is valid.
+ * @return false Otherwise.
+ */
+static inline bool parseDriverOptions(int argc, char* argv[], DriverOptions& opts, std::string& error) {
+    int positional = 0;
+    bool hasIv = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") == 0) {
+            if (i + 1 >= argc) {
+                error = "Missing value for option " + arg;
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--trace") {
+                opts.traceFile = value;
+            } else if (arg == "--metrics-port") {
+                opts.metricsPort = std::atoi(value.c_str());
+                if (opts.metricsPort <= 0 || opts.metricsPort > 65535) {
+                    error = "Invalid metrics port " + value;
+                    return false;
+                }
+            } else if (arg == "--metrics-socket") {
+                opts.metricsSocket = value;
+            } else if (arg == "--threads") {
+                opts.threads = std::atoi(value.c_str());
+                if (opts.threads <= 0) {
+                    error = "Invalid thread count " + value;
+                    return false;
+                }
+            } else if (arg == "--deadline") {
+                opts.deadlineSeconds = std::atof(value.c_str());
+                if (opts.deadlineSeconds <= 0) {
+                    error = "Invalid deadline " + value;
+                    return false;
+                }
+            } else if (arg == "--prior") {
+                if (!parseKeyPrior(value, opts.prior)) {
+                    error = "Unknown prior " + value;
+                    return false;
+                }
+            } else if (arg == "--checkpoint") {
+                opts.checkpointFile = value;
+            } else if (arg == "--input-format") {
+                if (!parseCipherFormat(value, opts.inputFormat)) {
+                    error = "Unknown input format " + value;
+                    return false;
+                }
+            } else if (arg == "--crib-offset") {
+                opts.cribOffset = std::atol(value.c_str());
+                if (opts.cribOffset < 0) {
+                    error = "Invalid crib offset " + value;
+                    return false;
+                }
+            } else if (arg == "--dump-ciphertext") {
+                opts.dumpCiphertext = value;
+            } else if (arg == "--corpus") {
+                opts.corpus = value;
+            } else if (arg == "--corpus-mode") {
+                if (value == kCorpusModeNames[CORPUS_JOBS]) {
+                    opts.corpusMode = CORPUS_JOBS;
+                } else if (value == kCorpusModeNames[CORPUS_SWEEP]) {
+                    opts.corpusMode = CORPUS_SWEEP;
+                } else {
+                    error = "Unknown corpus mode " + value;
+                    return false;
+                }
+            } else if (arg == "--cache") {
+                opts.cacheDir = value;
+            } else if (arg == "--mode") {
+                if (value == kEngineNames[ENGINE_DES_ECB]) {
+                    opts.engine = ENGINE_DES_ECB;
+                } else if (value == kEngineNames[ENGINE_DES_CBC]) {
+                    opts.engine = ENGINE_DES_CBC;
+                } else if (value == kEngineNames[ENGINE_RC4_40]) {
+                    opts.engine = ENGINE_RC4_40;
+                } else {
+                    error = "Unknown mode " + value;
+                    return false;
+                }
+            } else if (arg == "--iv") {
+                std::vector<unsigned char> bytes;
+                if (!decodeHex(value, bytes) || bytes.size() != sizeof(opts.iv)) {
+                    error = "Invalid IV " + value + " (expected 16 hex digits)";
+                    return false;
+                }
+                memcpy(opts.iv, bytes.data(), sizeof(opts.iv));
+                hasIv = true;
+            } else if (arg == "--pair") {
+                ExtraPair pair;
+                size_t first = value.find(':');
+                size_t second = first == std::string::npos ? first : value.find(':', first + 1);
+                char* end = nullptr;
+                if (first != std::string::npos) {
+                    pair.cipherFile = value.substr(0, first);
+                    pair.phraseFile = value.substr(first + 1, second == std::string::npos ? second : second - first - 1);
+                }
+                if (second != std::string::npos) {
+                    pair.cribOffset = std::strtol(value.c_str() + second + 1, &end, 10);
+                }
+                if (pair.cipherFile.empty() || pair.phraseFile.empty() ||
+                    (second != std::string::npos &&
+                     (second + 1 == value.size() || *end != '\0' || pair.cribOffset < 0))) {
+                    error = "Invalid pair " + value + " (expected <file>:<phrase file>[:<crib offset>])";
+                    return false;
+                }
+                opts.pairs.push_back(pair);
+            } else {
+                error = "Unknown option " + arg;
+                return false;
+            }
+        } else if (positional == 0) {
+            opts.inputFile = arg;
+            ++positional;
+        } else if (positional == 1) {
+            opts.encryptionKey = arg;
+            ++positional;
+        } else if (positional == 2) {
+            opts.searchPhraseFile = arg;
+            ++positional;
+        } else {
+            error = "Unexpected argument " + arg;
+            return false;
+        }
+    }
+    if (positional != 3) {
+        error = "Expected three positional arguments";
+        return false;
+    }
+    if (opts.inputFormat == FORMAT_PLAIN && opts.cribOffset >= 0) {
+        error = "--crib-offset needs a ciphertext input format";
+        return false;
+    }
+    if (opts.inputFormat != FORMAT_PLAIN && !opts.dumpCiphertext.empty()) {
+        error = "--dump-ciphertext needs the plain input format";
+        return false;
+    }
+    if (!opts.corpus.empty() && opts.inputFormat == FORMAT_PLAIN) {
+        error = "--corpus needs a ciphertext input format";
+        return false;
+    }
+    if (!opts.corpus.empty() && !opts.checkpointFile.empty()) {
+        error = "--checkpoint cannot be combined with --corpus";
+        return false;
+    }
+    if (!opts.pairs.empty() && (opts.inputFormat == FORMAT_PLAIN || !opts.corpus.empty())) {
+        error = "--pair needs a single ciphertext input (a ciphertext input format, no --corpus)";
+        return false;
+    }
+    if (hasIv && opts.engine != ENGINE_DES_CBC) {
+        error = "--iv needs --mode cbc";
+        return false;
+    }
+    return true;
+}
+
+#endif  // DRIVER_OPTIONS_H
@@ -0,0 +1,180 @@
+/**
+ * @file hdr_histogram.h
+ * @brief High-dynamic-range latency histogram that can be merged across ranks.
+ *
+ * Values are bucketed log-linearly: each power-of-two range is split into 64 equal
+ * sub-buckets, which keeps the relative error of any reported percentile below 1/64
+ * over the full 64-bit range with a fixed 30 KB table. Because the bucket layout is the
+ * same everywhere, histograms of different ranks merge by adding their counts.
+ *
+ * @date October 2024
+ */
+
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Log-linear histogram of non-negative integer values (e.g. microseconds).
+ */
+class HdrHistogram {
+public:
+    static const int kSubBucketBits = 7;
+    static const uint64_t kSubBuckets = 1ULL << kSubBucketBits;
+    static const uint64_t kHalf = kSubBuckets / 2;
+    static const int kBucketCount = (64 - kSubBucketBits + 2) * kHalf;
+
+    HdrHistogram() : counts(kBucketCount, 0), total(0), sum(0), minValue(UINT64_MAX), maxValue(0) {}
+
+    /**
+     * @brief Records one value.
+     */
+    void record(uint64_t value) {
+        ++counts[indexOf(value)];
+        ++total;
+        sum += value;
+        minValue = std::min(minValue, value);
+        maxValue = std::max(maxValue, value);
+    }
+
+    /// Number of recorded values.
+    uint64_t count() const { return total; }
+
+    /// Sum of recorded values.
+    double totalSum() const { return sum; }
+
+    /// Largest recorded value (0 when empty).
+    uint64_t max() const { return maxValue; }
+
+    /// Smallest recorded value (0 when empty).
+    uint64_t min() const { return total ? minValue : 0; }
+
+    /**
+     * @brief Returns the value at the given percentile (0-100), rounded to its bucket.
+     */
+    uint64_t percentile(double p) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * total + 0.5);
+        rank = std::max<uint64_t>(1, std::min(rank, total));
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(std::max(highestEquivalent(i), minValue), maxValue);
+            }
+        }
+        return maxValue;
+    }
+
+    /**
+     * @brief Counts the values below `bound`; exact when `bound` is a power of two.
+     */
+    uint64_t countBelow(uint64_t bound) const {
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount && highestEquivalent(i) < bound; ++i) {
+            seen += counts[i];
+        }
+        return seen;
+    }
+
+    /**
+     * @brief Adds the counts of `other` to this histogram.
+     */
+    void add(const HdrHistogram& other) {
+        for (int i = 0; i < kBucketCount; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        minValue = std::min(minValue, other.minValue);
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    /**
+     * @brief Merges the histograms of all ranks into process 0's result. Collective over `comm`.
+     */
+    HdrHistogram reduce(MPI_Comm comm) const {
+        HdrHistogram merged;
+        MPI_Reduce(counts.data(), merged.counts.data(), kBucketCount, MPI_UINT64_T, MPI_SUM, 0, comm);
+        MPI_Reduce(&total, &merged.total, 1, MPI_UINT64_T, MPI_SUM, 0, comm);
+        MPI_Reduce(&sum, &merged.sum, 1, MPI_DOUBLE, MPI_SUM, 0, comm);
+        MPI_Reduce(&minValue, &merged.minValue, 1, MPI_UINT64_T, MPI_MIN, 0, comm);
+        MPI_Reduce(&maxValue, &merged.maxValue, 1, MPI_UINT64_T, MPI_MAX, 0, comm);
+        return merged;
+    }
+
+    /**
+     * @brief Formats a one-line percentile summary, e.g. for the end-of-job report.
+     */
+    std::string summary(const char* unit) const {
+        char line[256];
+        snprintf(line, sizeof(line), "n=%llu min=%llu p50=%llu p90=%llu p99=%llu max=%llu %s",
+                 static_cast<unsigned long long>(total), static_cast<unsigned long long>(min()),
+                 static_cast<unsigned long long>(percentile(50)), static_cast<unsigned long long>(percentile(90)),
+                 static_cast<unsigned long long>(percentile(99)), static_cast<unsigned long long>(max()), unit);
+        return line;
+    }
+
+    /**
+     * @brief Renders the histogram in the Prometheus text format with power-of-two `le` bounds.
+     *
+     * A bucket counts the values below its bound, which differs from `le` only for values
+     * exactly equal to a power of two.
+     *
+     * @param name Metric name (without the _bucket/_sum/_count suffixes).
+     * @param help Description of the metric.
+     * @param scale Factor converting recorded values to the exported unit (e.g. 1e-6 for us -> s).
+     */
+    std::string prometheus(const std::string& name, const std::string& help, double scale) const {
+        std::ostringstream out;
+        out << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " histogram\n";
+        int top = 0;
+        while (top < 63 && (1ULL << top) < maxValue) {
+            ++top;
+        }
+        for (int b = 0; b <= top; ++b) {
+            uint64_t bound = 1ULL << b;
+            out << name << "_bucket{le=\"" << bound * scale << "\"} " << countBelow(bound) << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << total << "\n"
+            << name << "_sum " << sum * scale << "\n"
+            << name << "_count " << total << "\n";
+        return out.str();
+    }
+
+private:
+    static int indexOf(uint64_t value) {
+        if (value < kSubBuckets) {
+            return static_cast<int>(value);
+        }
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - kSubBucketBits + 1;
+        return static_cast<int>(shift * kHalf + (value >> shift));
+    }
+
+    static uint64_t highestEquivalent(int index) {
+        if (static_cast<uint64_t>(index) < kSubBuckets) {
+            return index;
+        }
+        int shift = index / kHalf - 1;
+        return ((index - shift * kHalf + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    double sum;
+    uint64_t minValue;
+    uint64_t maxValue;
+};
+
+#endif  // HDR_HISTOGRAM_H
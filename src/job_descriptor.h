@@ -0,0 +1,338 @@
+/**
+ * @file job_descriptor.h
+ * @brief Serialized description of a key search, distributed to the workers in one broadcast.
+ *
+ * Process 0 is the only process that sees the plaintext and the encryption key. It encrypts
+ * the plaintext, locates the search phrase in it and builds a JobDescriptor holding only
+ * what a worker needs to test keys: the ciphertext blocks that cover the phrase, the phrase
+ * and its offset in those blocks, the key space and the engine options. The descriptor is
+ * packed into a byte buffer and broadcast; descriptors up to kJobInlineBytes (the common
+ * case) take a single `MPI_Bcast`, larger ones a second one for the remainder.
+ *
+ * In CBC mode a plaintext block is D_k(C_i) XOR C_(i-1), with the IV before the first
+ * block. A window therefore carries the one block it is chained to (`chain`): workers
+ * decrypt the window block by block exactly as in ECB and XOR it in afterwards, so the
+ * hot path costs the same in both modes. Full CBC decryption is left to the verification.
+ *
+ * A stream cipher (RC4) has no blocks to decrypt independently: its keystream is generated
+ * from the start of the message, so a window is decrypted `windowOffset` bytes into it and
+ * costs the keystream up to its end.
+ *
+ * @date October 2024
+ */
+
+#ifndef JOB_DESCRIPTOR_H
+#define JOB_DESCRIPTOR_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Cipher engines a job can be searched with.
+ */
+enum Engine : uint32_t {
+    ENGINE_DES_ECB,  ///< Single DES in ECB mode (OpenSSL).
+    ENGINE_DES_CBC,  ///< Single DES in CBC mode (OpenSSL); the window is decrypted as in ECB, then unchained.
+    ENGINE_RC4_40    ///< RC4 with a 40-bit key; the window is decrypted at its offset in the keystream.
+};
+
+/// Names of the engines, as given to --mode.
+static const char* const kEngineNames[] = {"ecb", "cbc", "rc4-40"};
+
+/// Size of the first broadcast; descriptors that fit need no second one.
+static const size_t kJobInlineBytes = 1024;
+
+/**
+ * @brief Everything a worker needs to search for a key, and nothing more.
+ */
+struct JobDescriptor {
+    uint32_t engine = ENGINE_DES_ECB;  ///< Engine.
+    uint64_t keyspace = 1ULL << 56;    ///< Keys [0, keyspace) are searched.
+    uint64_t chunkSize = 1000000;      ///< Keys per chunk.
+    uint32_t cipherLength = 0;         ///< Length of the full ciphertext (bytes).
+    uint32_t windowOffset = 0;         ///< Offset of `ciphertext` within the full ciphertext.
+    int32_t cribOffset = -1;           ///< Offset of the phrase in the decrypted window; -1 for anywhere.
+    unsigned char iv[8] = {};          ///< CBC: initialization vector of the full ciphertext.
+    unsigned char chain[8] = {};       ///< CBC: block chained into the window (the IV or the block before it).
+    std::vector<unsigned char> ciphertext;  ///< Ciphertext blocks the predicate decrypts.
+    std::string phrase;                     ///< Search phrase expected in the plaintext.
+
+    /**
+     * @brief Checks whether the decrypted window satisfies the predicate.
+     *
+     * @param decrypted The decrypted `ciphertext` (ciphertext.size() bytes).
+     */
+    inline bool matches(const unsigned char* decrypted) const {
+        if (cribOffset >= 0) {
+            return memcmp(decrypted + cribOffset, phrase.data(), phrase.size()) == 0;
+        }
+        return memmem(decrypted, ciphertext.size(), phrase.data(), phrase.size()) != nullptr;
+    }
+
+    /**
+     * @brief Undoes the CBC chaining of the decrypted window (nothing in ECB mode).
+     *
+     * @param decrypted The window decrypted block by block; turned into its plaintext.
+     */
+    inline void unchain(unsigned char* decrypted) const {
+        if (engine != ENGINE_DES_CBC) {
+            return;
+        }
+        for (size_t i = ciphertext.size(); i-- > 8;) {
+            decrypted[i] ^= ciphertext[i - 8];
+        }
+        for (int i = 0; i < 8; ++i) {
+            decrypted[i] ^= chain[i];
+        }
+    }
+
+    /**
+     * @brief Returns the IV to decrypt a ciphertext of this job in CBC mode, or nullptr in ECB mode.
+     *
+     * @param length Length of the ciphertext: the full ciphertext starts from the IV, the
+     * window alone (as loaded from a raw file) from `chain`.
+     */
+    inline const unsigned char* ivFor(size_t length) const {
+        if (engine != ENGINE_DES_CBC) {
+            return nullptr;
+        }
+        return length == cipherLength ? iv : chain;
+    }
+
+    /**
+     * @brief Estimates the fraction of wrong keys that pass the predicate, taking their
+     * decryptions for random bytes: 2^-8 per phrase byte, times the number of places the
+     * phrase may start at.
+     */
+    inline double passRate() const {
+        size_t places = cribOffset >= 0 ? 1 : ciphertext.size() - std::min(phrase.size(), ciphertext.size()) + 1;
+        return std::min(1.0, std::ldexp(static_cast<double>(places), -8 * static_cast<int>(phrase.size())));
+    }
+
+    /**
+     * @brief Returns the bytes the cipher processes to test a key: the window, and for a
+     * stream cipher the keystream before it.
+     */
+    inline double testCost() const {
+        return static_cast<double>(ciphertext.size()) + (engine == ENGINE_RC4_40 ? windowOffset : 0);
+    }
+
+    /**
+     * @brief Returns the offset of a ciphertext of this job in the full ciphertext, where a
+     * stream cipher starts decrypting it.
+     *
+     * @param length Length of the ciphertext: 0 for the full ciphertext, `windowOffset` for
+     * the window alone (as loaded from a raw file).
+     */
+    inline size_t offsetFor(size_t length) const { return length == cipherLength ? 0 : windowOffset; }
+
+    /**
+     * @brief Finds the first 8-byte block of the window whose plaintext is fully known.
+     *
+     * @param offset Set to the block's offset in the window.
+     * @return true If the phrase covers a whole aligned block.
+     */
+    inline bool knownBlock(size_t& offset) const {
+        if (cribOffset < 0) {
+            return false;
+        }
+        offset = (cribOffset + 7) / 8 * 8;
+        return offset + 8 <= cribOffset + phrase.size();
+    }
+
+    /**
+     * @brief Returns the block the cipher encrypts at a known block: its plaintext, XORed in
+     * CBC mode with the block it is chained to.
+     *
+     * @param offset Offset of the known block in the window (see knownBlock).
+     * @param input Set to the 8-byte block.
+     */
+    inline void knownInput(size_t offset, unsigned char* input) const {
+        memcpy(input, phrase.data() + offset - cribOffset, 8);
+        if (engine == ENGINE_DES_CBC) {
+            const unsigned char* previous = offset == 0 ? chain : ciphertext.data() + offset - 8;
+            for (int i = 0; i < 8; ++i) {
+                input[i] ^= previous[i];
+            }
+        }
+    }
+};
+
+/**
+ * @brief Builds the job for a ciphertext whose plaintext holds the phrase at a known offset.
+ *
+ * Only the 8-byte blocks covering the phrase are kept and the predicate compares at that
+ * offset. Without a known offset the whole ciphertext is kept and the phrase may appear
+ * anywhere in it.
+ *
+ * @param ciphertext The full ciphertext.
+ * @param length Its length (a multiple of 8 for DES).
+ * @param phrase The search phrase.
+ * @param cribOffset Offset of the phrase in the plaintext, or -1 when unknown.
+ * @param iv The IV of a CBC ciphertext, or nullptr for ECB.
+ */
+static inline JobDescriptor makeWindowJob(const unsigned char* ciphertext, size_t length, const std::string& phrase,
+                                          long cribOffset, const unsigned char* iv = nullptr) {
+    JobDescriptor job;
+    job.cipherLength = length;
+    job.phrase = phrase;
+    if (iv != nullptr) {
+        job.engine = ENGINE_DES_CBC;
+        memcpy(job.iv, iv, 8);
+        memcpy(job.chain, iv, 8);
+    }
+    if (cribOffset < 0 || phrase.empty()) {
+        job.ciphertext.assign(ciphertext, ciphertext + length);
+        return job;
+    }
+    size_t first = cribOffset / 8 * 8;
+    size_t last = std::min(length, (cribOffset + phrase.size() + 7) / 8 * 8);
+    job.windowOffset = first;
+    job.cribOffset = cribOffset - first;
+    job.ciphertext.assign(ciphertext + first, ciphertext + last);
+    if (iv != nullptr && first > 0) {
+        memcpy(job.chain, ciphertext + first - 8, 8);
+    }
+    return job;
+}
+
+/**
+ * @brief Builds the job for a ciphertext whose plaintext is known to process 0.
+ *
+ * The crib is the first occurrence of the phrase in the plaintext (see makeWindowJob).
+ *
+ * @param ciphertext The full ciphertext.
+ * @param length Its length (a multiple of 8).
+ * @param plaintext The plaintext it was encrypted from.
+ * @param phrase The search phrase.
+ * @param iv The IV of a CBC ciphertext, or nullptr for ECB.
+ */
+static inline JobDescriptor makeJob(const unsigned char* ciphertext, int length, const std::string& plaintext,
+                                    const std::string& phrase, const unsigned char* iv = nullptr) {
+    size_t pos = plaintext.find(phrase);
+    return makeWindowJob(ciphertext, length, phrase, pos == std::string::npos ? -1 : static_cast<long>(pos), iv);
+}
+
+/**
+ * @brief Orders the pairs of a multi-pair job so that testing a key costs the least.
+ *
+ * A key is tested against the pairs in order and dropped at the first one it fails. With
+ * independent pass rates p_i and costs c_i, the expected cost c_1 + p_1 c_2 + p_1 p_2 c_3 + ...
+ * is minimal in increasing order of c_i / (1 - p_i). The first pair becomes the hot-loop
+ * filter; the others only see its survivors.
+ *
+ * @param pairs Jobs searched for the same key, reordered in place.
+ */
+static inline void orderBySelectivity(std::vector<JobDescriptor>& pairs) {
+    auto rank = [](const JobDescriptor& pair) {
+        double rejects = 1.0 - pair.passRate();
+        return rejects > 0 ? pair.testCost() / rejects : HUGE_VAL;
+    };
+    std::stable_sort(pairs.begin(), pairs.end(),
+                     [&rank](const JobDescriptor& a, const JobDescriptor& b) { return rank(a) < rank(b); });
+}
+
+/**
+ * @brief Serializes a job into a flat byte buffer.
+ */
+static inline std::vector<char> packJob(const JobDescriptor& job) {
+    uint32_t cipherBytes = job.ciphertext.size();
+    uint32_t phraseBytes = job.phrase.size();
+    std::vector<char> out;
+    auto put = [&out](const void* p, size_t n) {
+        out.insert(out.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+    };
+    put(&job.engine, sizeof(job.engine));
+    put(&job.keyspace, sizeof(job.keyspace));
+    put(&job.chunkSize, sizeof(job.chunkSize));
+    put(&job.cipherLength, sizeof(job.cipherLength));
+    put(&job.windowOffset, sizeof(job.windowOffset));
+    put(&job.cribOffset, sizeof(job.cribOffset));
+    put(job.iv, sizeof(job.iv));
+    put(job.chain, sizeof(job.chain));
+    put(&cipherBytes, sizeof(cipherBytes));
+    put(&phraseBytes, sizeof(phraseBytes));
+    put(job.ciphertext.data(), cipherBytes);
+    put(job.phrase.data(), phraseBytes);
+    return out;
+}
+
+/**
+ * @brief Deserializes a job packed by packJob.
+ *
+ * @return true If the buffer holds a complete job.
+ */
+static inline bool unpackJob(const char* data, size_t size, JobDescriptor& job) {
+    size_t at = 0;
+    auto get = [&](void* p, size_t n) {
+        if (at + n > size) {
+            return false;
+        }
+        memcpy(p, data + at, n);
+        at += n;
+        return true;
+    };
+    uint32_t cipherBytes, phraseBytes;
+    if (!get(&job.engine, sizeof(job.engine)) || !get(&job.keyspace, sizeof(job.keyspace)) ||
+        !get(&job.chunkSize, sizeof(job.chunkSize)) || !get(&job.cipherLength, sizeof(job.cipherLength)) ||
+        !get(&job.windowOffset, sizeof(job.windowOffset)) || !get(&job.cribOffset, sizeof(job.cribOffset)) ||
+        !get(job.iv, sizeof(job.iv)) || !get(job.chain, sizeof(job.chain)) || !get(&cipherBytes, sizeof(cipherBytes)) ||
+        !get(&phraseBytes, sizeof(phraseBytes)) || at + cipherBytes + phraseBytes > size) {
+        return false;
+    }
+    job.ciphertext.assign(data + at, data + at + cipherBytes);
+    job.phrase.assign(data + at + cipherBytes, phraseBytes);
+    return true;
+}
+
+/**
+ * @brief Broadcasts process 0's job to every process. Collective over `comm`.
+ *
+ * The first broadcast carries the packed size followed by as much of the descriptor as
+ * fits in kJobInlineBytes; only larger descriptors need a second broadcast.
+ *
+ * @param comm The communicator of the search.
+ * @param job The job; filled in on every process other than 0.
+ */
+static inline void broadcastJob(MPI_Comm comm, JobDescriptor& job) {
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<char> packed;
+    if (processId == 0) {
+        packed = packJob(job);
+    }
+    char head[kJobInlineBytes];
+    const size_t inlineBytes = kJobInlineBytes - sizeof(uint64_t);
+    uint64_t size = packed.size();
+    if (processId == 0) {
+        memcpy(head, &size, sizeof(size));
+        memcpy(head + sizeof(size), packed.data(), std::min<size_t>(size, inlineBytes));
+    }
+    MPI_Bcast(head, kJobInlineBytes, MPI_BYTE, 0, comm);
+    if (processId == 0) {
+        if (size > inlineBytes) {
+            MPI_Bcast(packed.data() + inlineBytes, size - inlineBytes, MPI_BYTE, 0, comm);
+        }
+        return;
+    }
+
+    memcpy(&size, head, sizeof(size));
+    packed.resize(size);
+    memcpy(packed.data(), head + sizeof(size), std::min<size_t>(size, inlineBytes));
+    if (size > inlineBytes) {
+        MPI_Bcast(packed.data() + inlineBytes, size - inlineBytes, MPI_BYTE, 0, comm);
+    }
+    if (!unpackJob(packed.data(), packed.size(), job)) {
+        std::fprintf(stderr, "Process %d received a malformed job descriptor\n", processId);
+        MPI_Abort(comm, 1);
+    }
+}
+
+#endif  // JOB_DESCRIPTOR_H
@@ -0,0 +1,77 @@
+/**
+ * @file load_report.h
+ * @brief End-of-job load-imbalance report gathered from every rank.
+ *
+ * With a static split of the key space the closing `MPI_Barrier` hides how unevenly the
+ * work was spread: a rank that finishes early simply waits there. Each rank therefore
+ * records how long it was busy searching, how long it was idle (polling or waiting at the
+ * barrier), how many keys it tested and how many chunks it completed, and process 0
+ * prints the per-rank table together with the max/mean imbalance factor.
+ *
+ * @date October 2024
+ */
+
+#ifndef LOAD_REPORT_H
+#define LOAD_REPORT_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/**
+ * @brief Work accounting of a single rank.
+ */
+struct RankLoad {
+    double busySeconds = 0;        ///< Time spent testing keys.
+    double idleSeconds = 0;        ///< Time spent polling or waiting for other ranks.
+    uint64_t keysTested = 0;       ///< Keys actually tried.
+    uint64_t chunksCompleted = 0;  ///< Chunks of the key range completed.
+};
+
+/**
+ * @brief Gathers the load of every rank on process 0 and prints the imbalance report.
+ *
+ * Collective over `comm`.
+ *
+ * @param comm The communicator of the search.
+ * @param load The load of the calling rank.
+ */
+static inline void printLoadReport(MPI_Comm comm, const RankLoad& load) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<RankLoad> loads(processId == 0 ? numProcesses : 0);
+    MPI_Gather(&load, sizeof(RankLoad), MPI_BYTE, loads.data(), sizeof(RankLoad), MPI_BYTE, 0, comm);
+    if (processId != 0) {
+        return;
+    }
+
+    double maxBusy = 0, sumBusy = 0;
+    double maxKeys = 0, sumKeys = 0;
+    for (const RankLoad& l : loads) {
+        maxBusy = std::max(maxBusy, l.busySeconds);
+        sumBusy += l.busySeconds;
+        maxKeys = std::max(maxKeys, static_cast<double>(l.keysTested));
+        sumKeys += l.keysTested;
+    }
+    double meanBusy = sumBusy / numProcesses;
+    double meanKeys = sumKeys / numProcesses;
+
+    std::printf("Load report:\n");
+    std::printf("%6s %12s %12s %16s %10s %12s\n", "Rank", "Busy [s]", "Idle [s]", "Keys tested", "Chunks", "Keys/s");
+    for (int r = 0; r < numProcesses; ++r) {
+        const RankLoad& l = loads[r];
+        std::printf("%6d %12.3f %12.3f %16llu %10llu %12.0f\n", r, l.busySeconds, l.idleSeconds,
+                    static_cast<unsigned long long>(l.keysTested),
+                    static_cast<unsigned long long>(l.chunksCompleted),
+                    l.busySeconds > 0 ? l.keysTested / l.busySeconds : 0.0);
+    }
+    std::printf("Imbalance factor (max/mean busy time): %.3f\n", meanBusy > 0 ? maxBusy / meanBusy : 1.0);
+    std::printf("Imbalance factor (max/mean keys tested): %.3f\n", meanKeys > 0 ? maxKeys / meanKeys : 1.0);
+    std::fflush(stdout);
+}
+
+#endif  // LOAD_REPORT_H
@@ -0,0 +1,452 @@
+/**
+ * @file metrics.h
+ * @brief Live Prometheus-style metrics of a running search, served by process 0.
+ *
+ * Every rank periodically sends a small progress report to process 0 on a duplicated
+ * communicator with a nonblocking send. Process 0 drains the reports between chunks,
+ * renders them in the Prometheus text exposition format and serves the latest snapshot
+ * over HTTP on a localhost TCP port or a Unix domain socket from a background thread,
+ * so scraping never touches the search threads.
+ *
+ * Latency samples (chunk time, stop latency, ...) travel with the progress reports and
+ * are recorded into HDR histograms on process 0, exported as Prometheus histograms.
+ *
+ * @date October 2024
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <mpi.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hdr_histogram.h"
+
+/**
+ * @brief Latency distributions exported as histograms (all recorded in microseconds).
+ */
+enum LatencyMetric {
+    LATENCY_CHUNK,       ///< Time to complete one chunk.
+    LATENCY_STOP,        ///< Time from a key being found to a rank stopping.
+    LATENCY_LEASE,       ///< Round trip of a request for more work.
+    LATENCY_TURNAROUND,  ///< Submission-to-result time of a job.
+    NUM_LATENCY_METRICS
+};
+
+static const char* const kLatencyNames[NUM_LATENCY_METRICS] = {
+    "bruteforce_chunk_seconds", "bruteforce_stop_latency_seconds",
+    "bruteforce_lease_rtt_seconds", "bruteforce_job_turnaround_seconds"
+};
+
+static const char* const kLatencyHelp[NUM_LATENCY_METRICS] = {
+    "Time to complete one chunk of keys.",
+    "Time from a key being found to a rank stopping its search.",
+    "Round-trip time of a request for more work.",
+    "Time from submitting a job to its result."
+};
+
+/**
+ * @brief Minimal HTTP server that answers every request with the latest metrics text.
+ */
+class MetricsServer {
+public:
+    MetricsServer() : listenFd(-1), running(false) {}
+
+    ~MetricsServer() { stop(); }
+
+    /**
+     * @brief Listens on 127.0.0.1:`port`.
+     *
+     * @return false If the socket could not be bound; `error` describes why.
+     */
+    bool startTcp(int port, std::string& error) {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return listenOn(reinterpret_cast<sockaddr*>(&addr), sizeof(addr), error);
+    }
+
+    /**
+     * @brief Listens on the Unix domain socket `path`, replacing any stale socket file.
+     *
+     * @return false If the socket could not be bound; `error` describes why.
+     */
+    bool startUnix(const std::string& path, std::string& error) {
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+        unixPath = path;
+        return listenOn(reinterpret_cast<sockaddr*>(&addr), sizeof(addr), error);
+    }
+
+    /**
+     * @brief Replaces the text returned to subsequent scrapes.
+     */
+    void publish(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mtx);
+        body = text;
+    }
+
+    /**
+     * @brief Stops the server thread and closes the socket.
+     */
+    void stop() {
+        if (running.exchange(false)) {
+            worker.join();
+        }
+        if (listenFd >= 0) {
+            close(listenFd);
+            listenFd = -1;
+        }
+        if (!unixPath.empty()) {
+            unlink(unixPath.c_str());
+            unixPath.clear();
+        }
+    }
+
+private:
+    bool listenOn(const sockaddr* addr, socklen_t len, std::string& error) {
+        if (listenFd < 0 || bind(listenFd, addr, len) != 0 || listen(listenFd, 8) != 0) {
+            error = std::string("Failed to open metrics socket: ") + strerror(errno);
+            return false;
+        }
+        running = true;
+        worker = std::thread(&MetricsServer::serve, this);
+        return true;
+    }
+
+    void serve() {
+        while (running) {
+            pollfd pfd = {listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) {
+                continue;
+            }
+            int client = accept(listenFd, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+
+            // The request itself is irrelevant: every path returns the metrics
+            char request[1024];
+            pollfd cfd = {client, POLLIN, 0};
+            if (poll(&cfd, 1, 1000) > 0) {
+                ssize_t ignored = recv(client, request, sizeof(request), 0);
+                (void)ignored;
+            }
+
+            std::string text;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                text = body;
+            }
+            std::ostringstream response;
+            response << "HTTP/1.1 200 OK\r\n"
+                     << "Content-Type: text/plain; version=0.0.4\r\n"
+                     << "Content-Length: " << text.size() << "\r\n"
+                     << "Connection: close\r\n\r\n"
+                     << text;
+            std::string out = response.str();
+            size_t sent = 0;
+            while (sent < out.size()) {
+                ssize_t n = send(client, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    break;
+                }
+                sent += n;
+            }
+            close(client);
+        }
+    }
+
+    int listenFd;
+    std::atomic<bool> running;
+    std::thread worker;
+    std::mutex mtx;
+    std::string body;
+    std::string unixPath;
+};
+
+/**
+ * @brief Progress of one rank, sent to process 0 as raw bytes followed by its latency samples.
+ */
+struct ProgressReport {
+    uint64_t keysTested;    ///< Keys tried so far.
+    uint64_t jobKeysTested; ///< Keys tried in the current job.
+    uint64_t candidates;    ///< Keys that passed the search predicate.
+    uint64_t rejected;      ///< Candidates that failed verification (false positives).
+    double elapsedSeconds;  ///< Wall time since the search started.
+    int32_t done;           ///< Nonzero in the last report of the rank.
+};
+
+/**
+ * @brief One latency observation carried by a progress report.
+ */
+struct LatencySample {
+    uint64_t micros;  ///< Observed latency in microseconds.
+    uint64_t metric;  ///< LatencyMetric.
+};
+
+/**
+ * @brief Collects progress from all ranks and publishes it through a MetricsServer.
+ *
+ * Every rank constructs it and calls `update()` between chunks and `finish()` once after
+ * the search; when metrics are disabled both are no-ops and no communication happens.
+ */
+class MetricsReporter {
+public:
+    /**
+     * @brief Sets up the reporter. Collective over `comm` when `port` or `socketPath` is set.
+     *
+     * @param comm The communicator of the search.
+     * @param keyspace Total number of keys of the (first) job, searched by all ranks.
+     * @param port TCP port on localhost, or 0.
+     * @param socketPath Unix socket path, or empty.
+     */
+    MetricsReporter(MPI_Comm comm, double keyspace, int port, const std::string& socketPath)
+        : enabled(port != 0 || !socketPath.empty()), keyspace(keyspace), jobBase(0), pending(MPI_REQUEST_NULL),
+          start(std::chrono::steady_clock::now()), lastReport(start) {
+        if (!enabled) {
+            return;
+        }
+        MPI_Comm_dup(comm, &metricsComm);
+        MPI_Comm_size(metricsComm, &numProcesses);
+        MPI_Comm_rank(metricsComm, &processId);
+        if (processId == 0) {
+            reports.assign(numProcesses, ProgressReport());
+            histograms.resize(NUM_LATENCY_METRICS);
+            std::string error;
+            bool ok = port != 0 ? server.startTcp(port, error) : server.startUnix(socketPath, error);
+            if (!ok) {
+                std::cerr << error << std::endl;
+            }
+            render();
+        }
+    }
+
+    /**
+     * @brief Starts a new job: coverage and ETA are reported against its key space from now on.
+     *
+     * Called by every rank at the start of each job of a corpus, with the keys the rank has
+     * tested so far; the cumulative counters keep growing across jobs.
+     */
+    void beginJob(uint64_t keysTested, double jobKeyspace) {
+        jobBase = keysTested;
+        keyspace = jobKeyspace;
+    }
+
+    /**
+     * @brief Records a latency sample; it reaches process 0 with the next report.
+     */
+    void observe(LatencyMetric metric, uint64_t micros) {
+        if (!enabled) {
+            return;
+        }
+        if (processId == 0) {
+            histograms[metric].record(micros);
+        } else {
+            LatencySample sample = {micros, static_cast<uint64_t>(metric)};
+            samples.push_back(sample);
+        }
+    }
+
+    /**
+     * @brief Reports the progress of the calling rank at most once per second.
+     *
+     * On process 0 also drains the reports of the other ranks and refreshes the metrics.
+     */
+    void update(uint64_t keysTested, uint64_t candidates, uint64_t rejected) {
+        if (!enabled) {
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport < std::chrono::seconds(1)) {
+            return;
+        }
+        lastReport = now;
+        ProgressReport report = makeReport(keysTested, candidates, rejected, 0);
+
+        if (processId == 0) {
+            reports[0] = report;
+            drain(false);
+            render();
+        } else {
+            MPI_Wait(&pending, MPI_STATUS_IGNORE);
+            pack(report);
+            MPI_Isend(outgoing.data(), outgoing.size(), MPI_BYTE, 0, 0, metricsComm, &pending);
+        }
+    }
+
+    /**
+     * @brief Sends the final report of every rank and stops the server. Collective.
+     */
+    void finish(uint64_t keysTested, uint64_t candidates, uint64_t rejected) {
+        if (!enabled) {
+            return;
+        }
+        ProgressReport report = makeReport(keysTested, candidates, rejected, 1);
+        if (processId == 0) {
+            reports[0] = report;
+            drain(true);
+            render();
+            server.stop();
+        } else {
+            MPI_Wait(&pending, MPI_STATUS_IGNORE);
+            pack(report);
+            MPI_Send(outgoing.data(), outgoing.size(), MPI_BYTE, 0, 0, metricsComm);
+        }
+        MPI_Comm_free(&metricsComm);
+    }
+
+private:
+    ProgressReport makeReport(uint64_t keysTested, uint64_t candidates, uint64_t rejected, int done) const {
+        ProgressReport report;
+        report.keysTested = keysTested;
+        report.jobKeysTested = keysTested - jobBase;
+        report.candidates = candidates;
+        report.rejected = rejected;
+        report.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        report.done = done;
+        return report;
+    }
+
+    /**
+     * @brief Serializes a report and the buffered samples into `outgoing`.
+     */
+    void pack(const ProgressReport& report) {
+        outgoing.resize(sizeof(ProgressReport) + samples.size() * sizeof(LatencySample));
+        memcpy(outgoing.data(), &report, sizeof(ProgressReport));
+        if (!samples.empty()) {
+            memcpy(outgoing.data() + sizeof(ProgressReport), samples.data(), samples.size() * sizeof(LatencySample));
+        }
+        samples.clear();
+    }
+
+    /**
+     * @brief Receives pending reports; with `untilDone`, blocks until every rank sent its last one.
+     */
+    void drain(bool untilDone) {
+        int remaining = 0;
+        for (int r = 1; r < numProcesses; ++r) {
+            remaining += reports[r].done ? 0 : 1;
+        }
+        while (true) {
+            int flag = 0;
+            MPI_Status status;
+            if (untilDone && remaining > 0) {
+                MPI_Probe(MPI_ANY_SOURCE, 0, metricsComm, &status);
+                flag = 1;
+            } else {
+                MPI_Iprobe(MPI_ANY_SOURCE, 0, metricsComm, &flag, &status);
+            }
+            if (!flag) {
+                break;
+            }
+            int bytes = 0;
+            MPI_Get_count(&status, MPI_BYTE, &bytes);
+            std::vector<char> buffer(bytes);
+            MPI_Recv(buffer.data(), bytes, MPI_BYTE, status.MPI_SOURCE, 0, metricsComm, MPI_STATUS_IGNORE);
+
+            ProgressReport report;
+            memcpy(&report, buffer.data(), sizeof(ProgressReport));
+            for (size_t off = sizeof(ProgressReport); off + sizeof(LatencySample) <= buffer.size();
+                 off += sizeof(LatencySample)) {
+                LatencySample sample;
+                memcpy(&sample, buffer.data() + off, sizeof(LatencySample));
+                histograms[sample.metric].record(sample.micros);
+            }
+            if (report.done && !reports[status.MPI_SOURCE].done) {
+                --remaining;
+            }
+            reports[status.MPI_SOURCE] = report;
+        }
+    }
+
+    /**
+     * @brief Renders the latest reports in the Prometheus text format.
+     */
+    void render() {
+        double tested = 0, jobTested = 0, candidates = 0, rejected = 0, rate = 0;
+        std::ostringstream ranks;
+        for (int r = 0; r < numProcesses; ++r) {
+            const ProgressReport& p = reports[r];
+            double rankRate = p.elapsedSeconds > 0 ? p.keysTested / p.elapsedSeconds : 0;
+            tested += p.keysTested;
+            jobTested += p.jobKeysTested;
+            candidates += p.candidates;
+            rejected += p.rejected;
+            rate += rankRate;
+            ranks << "bruteforce_rank_keys_per_second{rank=\"" << r << "\"} " << rankRate << "\n";
+        }
+        double remaining = keyspace > jobTested ? keyspace - jobTested : 0;
+
+        std::ostringstream text;
+        text << "# HELP bruteforce_keys_per_second Global key testing rate.\n"
+             << "# TYPE bruteforce_keys_per_second gauge\n"
+             << "bruteforce_keys_per_second " << rate << "\n"
+             << "# HELP bruteforce_keys_tested_total Keys tested by all ranks.\n"
+             << "# TYPE bruteforce_keys_tested_total counter\n"
+             << "bruteforce_keys_tested_total " << tested << "\n"
+             << "# HELP bruteforce_coverage_ratio Fraction of the current job's key space tested.\n"
+             << "# TYPE bruteforce_coverage_ratio gauge\n"
+             << "bruteforce_coverage_ratio " << (keyspace > 0 ? jobTested / keyspace : 0) << "\n"
+             << "# HELP bruteforce_eta_seconds Time to exhaust the current job's key space at the current rate.\n"
+             << "# TYPE bruteforce_eta_seconds gauge\n"
+             << "bruteforce_eta_seconds " << (rate > 0 ? remaining / rate : -1) << "\n"
+             << "# HELP bruteforce_rank_keys_per_second Key testing rate of each rank.\n"
+             << "# TYPE bruteforce_rank_keys_per_second gauge\n"
+             << ranks.str()
+             << "# HELP bruteforce_candidates_verified_total Keys that passed the search predicate.\n"
+             << "# TYPE bruteforce_candidates_verified_total counter\n"
+             << "bruteforce_candidates_verified_total " << candidates << "\n"
+             << "# HELP bruteforce_false_positives_total Candidates rejected by verification.\n"
+             << "# TYPE bruteforce_false_positives_total counter\n"
+             << "bruteforce_false_positives_total " << rejected << "\n";
+        for (int m = 0; m < NUM_LATENCY_METRICS; ++m) {
+            if (histograms[m].count() > 0) {
+                text << histograms[m].prometheus(kLatencyNames[m], kLatencyHelp[m], 1e-6);
+            }
+        }
+        server.publish(text.str());
+    }
+
+    bool enabled;
+    double keyspace;
+    uint64_t jobBase;
+    MPI_Comm metricsComm;
+    int numProcesses;
+    int processId;
+    MPI_Request pending;
+    std::vector<char> outgoing;
+    std::vector<LatencySample> samples;
+    std::vector<ProgressReport> reports;
+    std::vector<HdrHistogram> histograms;
+    MetricsServer server;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastReport;
+};
+
+#endif  // METRICS_H
@@ -17,12 +17,16 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
-#include <openssl/des.h>
 #include <mpi.h>
 #include <chrono>
 #include <algorithm>
 #include <cctype>
 #include <locale>
+#include <vector>
+
+#include "cipher_policy.h"
+#include "job_descriptor.h"
+#include "load_report.h"
 
 #define DEBUG 0  // Set to 1 to enable debug messages
 
@@ -68,103 +72,21 @@ static inline void trim(std::string &s) {
 }
 
 /**
- * @brief Encrypts the plaintext using DES with the specified key.
- *
- * @param key The 8-byte DES key.
- * @param plaintext The input data to encrypt.
- * @param ciphertext The buffer to store encrypted data.
- * @param len Length of the plaintext.
- */
-void encrypt(const unsigned char* key, const unsigned char* plaintext, unsigned char* ciphertext, int len) {
-    DES_cblock keyBlock;
-    DES_key_schedule keySchedule;
-
-    memcpy(keyBlock, key, 8);
-
-    // Suppress deprecated warnings for OpenSSL DES functions
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-
-    // Set the key parity bits
-    DES_set_odd_parity(&keyBlock);
-
-    // Check if the key is weak or has incorrect parity
-    if (DES_set_key_checked(&keyBlock, &keySchedule) != 0) {
-        std::cerr << "Encryption key error in DES_set_key_checked" << std::endl;
-        exit(1);
-    }
-
-    for (int i = 0; i < len; i += 8) {
-        DES_ecb_encrypt((const_DES_cblock*)(plaintext + i), (DES_cblock*)(ciphertext + i), &keySchedule, DES_ENCRYPT);
-    }
-
-    #pragma GCC diagnostic pop  // Restore the previous warning settings
-}
-
-/**
- * @brief Decrypts the ciphertext using DES with the specified key.
- *
- * @param key The 8-byte DES key.
- * @param ciphertext The encrypted data.
- * @param plaintext The buffer to store decrypted data.
- * @param len Length of the ciphertext.
- */
-void decrypt(const unsigned char* key, const unsigned char* ciphertext, unsigned char* plaintext, int len) {
-    DES_cblock keyBlock;
-    DES_key_schedule keySchedule;
-
-    memcpy(keyBlock, key, 8);
-
-    // Suppress deprecated warnings for OpenSSL DES functions
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-
-    // Set the key parity bits
-    DES_set_odd_parity(&keyBlock);
-
-    // Check if the key is weak or has incorrect parity
-    if (DES_set_key_checked(&keyBlock, &keySchedule) != 0) {
-        #if DEBUG
-        std::cerr << "Decryption key error in DES_set_key_checked" << std::endl;
-        #endif
-        return;  // Skip decryption with this key
-    }
-
-    for (int i = 0; i < len; i += 8) {
-        DES_ecb_encrypt((const_DES_cblock*)(ciphertext + i), (DES_cblock*)(plaintext + i), &keySchedule, DES_DECRYPT);
-    }
-
-    #pragma GCC diagnostic pop  // Restore the previous warning settings
-}
-
-/**
- * @brief Converts a long integer to an 8-byte key.
- *
- * @param key The long integer key.
- * @param keyArray The buffer to store the converted 8-byte key.
- */
-void longToKey(long key, unsigned char* keyArray) {
-    for (int i = 0; i < 8; ++i) {
-        keyArray[7 - i] = (key >> (i * 8)) & 0xFF;
-    }
-}
-
-/**
- * @brief Attempts to decrypt the ciphertext with the given key and checks for the search phrase.
+ * @brief Attempts to decrypt the job's ciphertext with the given key and checks for the search phrase.
  *
  * @param key The long key to test.
- * @param ciphertext The encrypted data.
- * @param len Length of the ciphertext.
- * @param searchPhrase The phrase to search for in the decrypted text.
+ * @param job The job holding the ciphertext blocks and the search phrase.
  * @return true If the decrypted text contains the search phrase.
  * @return false Otherwise.
  */
-bool tryKey(long key, const unsigned char* ciphertext, int len, const std::string& searchPhrase) {
+template <typename Cipher>
+bool tryKey(long key, const JobDescriptor& job) {
+    int len = job.ciphertext.size();
     unsigned char temp[len + 1];
-    unsigned char keyArray[8];
+    unsigned char keyArray[Cipher::kKeyBytes];
 
-    longToKey(key, keyArray);
-    decrypt(keyArray, ciphertext, temp, len);
+    Cipher::keyFromInteger(key, keyArray);
+    Cipher::decrypt(keyArray, job.ciphertext.data(), temp, len);
     temp[len] = '\0';  // Null-terminate the decrypted text
 
     // Check if decryption was successful before searching
@@ -172,21 +94,24 @@ bool tryKey(long key, const unsigned char* ciphertext, int len, const std::strin
         return false;
     }
 
-    return strstr(reinterpret_cast<char*>(temp), searchPhrase.c_str()) != nullptr;
+    return job.matches(temp);
 }
 
-int main(int argc, char* argv[]) {
-    MPI_Init(&argc, &argv);
-
+/**
+ * @brief Runs the driver with the given cipher (cipher_policy.h).
+ *
+ * @return Process exit status.
+ */
+template <typename Cipher>
+static int runDriver(MPI_Comm comm, int argc, char* argv[]) {
     int numProcesses, processId;
-    MPI_Comm comm = MPI_COMM_WORLD;
 
     MPI_Comm_size(comm, &numProcesses);
     MPI_Comm_rank(comm, &processId);
 
     std::string plaintext;
     std::string searchPhrase;
-    long encryptionKey;
+    long encryptionKey = 0;
 
     // Process 0 reads the input files and broadcasts the data
     if (processId == 0) {
@@ -245,49 +170,29 @@ int main(int argc, char* argv[]) {
         std::cout << "Search phrase: -" << searchPhrase << "-" << std::endl;
     }
 
-    // Broadcast encryption key length and value
-    MPI_Bcast(&encryptionKey, 1, MPI_LONG, 0, comm);
-
-    // Broadcast plaintext length and content
-    int plaintextLength;
-    if (processId == 0) {
-        plaintextLength = plaintext.size();
-    }
-    MPI_Bcast(&plaintextLength, 1, MPI_INT, 0, comm);
-
-    if (processId != 0) {
-        plaintext.resize(plaintextLength);
-    }
-    MPI_Bcast(&plaintext[0], plaintextLength, MPI_CHAR, 0, comm);
-
-    // Broadcast search phrase length and content
-    int searchPhraseLength;
+    // Process 0 encrypts the plaintext and keeps the full ciphertext for verification; the
+    // other processes only receive the ciphertext blocks the predicate needs
+    JobDescriptor job;
+    std::vector<unsigned char> ciphertext;
+    unsigned char keyArray[Cipher::kKeyBytes];
     if (processId == 0) {
-        searchPhraseLength = searchPhrase.size();
-    }
-    MPI_Bcast(&searchPhraseLength, 1, MPI_INT, 0, comm);
-
-    if (processId != 0) {
-        searchPhrase.resize(searchPhraseLength);
+        // Make sure the plaintext length is a multiple of 8
+        int paddedLength = ((plaintext.size() + 7) / 8) * 8;
+        std::vector<unsigned char> plaintextBuffer(paddedLength, 0);
+        memcpy(plaintextBuffer.data(), plaintext.c_str(), plaintext.size());
+
+        // Convert encryption key to the cipher's key bytes
+        Cipher::keyFromInteger(encryptionKey, keyArray);
+
+        // Encrypt the plaintext
+        ciphertext.resize(paddedLength);
+        Cipher::encrypt(keyArray, plaintextBuffer.data(), ciphertext.data(), paddedLength);
+        job = makeJob(ciphertext.data(), paddedLength, plaintext, searchPhrase);
     }
-    MPI_Bcast(&searchPhrase[0], searchPhraseLength, MPI_CHAR, 0, comm);
-
-    // Make sure the plaintext length is a multiple of 8
-    int paddedLength = ((plaintext.size() + 7) / 8) * 8;
-    unsigned char plaintextBuffer[paddedLength];
-    memset(plaintextBuffer, 0, paddedLength);
-    memcpy(plaintextBuffer, plaintext.c_str(), plaintext.size());
-
-    // Convert encryption key to 8-byte DES key
-    unsigned char keyArray[8];
-    longToKey(encryptionKey, keyArray);
-
-    // Encrypt the plaintext
-    unsigned char ciphertext[paddedLength];
-    encrypt(keyArray, plaintextBuffer, ciphertext, paddedLength);
+    broadcastJob(comm, job);
 
     // Define key space and range for each process
-    long upperBound = (1L << 56);  // Full DES key space (adjust as needed for testing)
+    long upperBound = job.keyspace;  // Full DES key space (adjust as needed for testing)
     long keysPerProcess = upperBound / numProcesses;
     long lowerBound = keysPerProcess * processId;
     long upperBoundLocal = (processId == numProcesses - 1) ? upperBound : keysPerProcess * (processId + 1);
@@ -304,13 +209,15 @@ int main(int argc, char* argv[]) {
     // Brute-force key search
     const int CHECK_INTERVAL = 1000000;  // Check for messages every 1000 iterations
     long iteration = 0;
+    RankLoad load;
+    typedef std::chrono::duration<double> Seconds;
 
     for (long key = lowerBound; key < upperBoundLocal; ++key) {
         // Increment iteration counter
         ++iteration;
 
         // Try decrypting with the current key
-        if (tryKey(key, ciphertext, paddedLength, searchPhrase)) {
+        if (tryKey<Cipher>(key, job)) {
             foundKey = key;
             keyFound = 1;
 
@@ -325,6 +232,8 @@ int main(int argc, char* argv[]) {
 
         // Periodically check if another process has found the key
         if (iteration % CHECK_INTERVAL == 0) {
+            ++load.chunksCompleted;
+            auto pollStart = std::chrono::high_resolution_clock::now();
             int flag = 0;
             MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &flag, &status);
             if (flag) {
@@ -333,8 +242,10 @@ int main(int argc, char* argv[]) {
                 keyFound = 1;
                 break;  // Exit the main loop if key has been found
             }
+            load.idleSeconds += Seconds(std::chrono::high_resolution_clock::now() - pollStart).count();
         }
     }
+    load.keysTested = iteration;
 
     // After the loop, check for any remaining messages
     if (!keyFound) {
@@ -347,15 +258,19 @@ int main(int argc, char* argv[]) {
     }
 
     // End timing
+    auto searchEnd = std::chrono::high_resolution_clock::now();
     MPI_Barrier(comm);  // Ensure all processes have finished
     auto end = std::chrono::high_resolution_clock::now();
+    load.busySeconds = Seconds(searchEnd - start).count() - load.idleSeconds;
+    load.idleSeconds += Seconds(end - searchEnd).count();
 
     // Process 0 handles the output
     if (processId == 0) {
         if (keyFound) {
+            int paddedLength = ciphertext.size();
             unsigned char decryptedText[paddedLength + 1];
-            longToKey(foundKey, keyArray);
-            decrypt(keyArray, ciphertext, decryptedText, paddedLength);
+            Cipher::keyFromInteger(foundKey, keyArray);
+            Cipher::decrypt(keyArray, ciphertext.data(), decryptedText, paddedLength);
             decryptedText[paddedLength] = '\0';
             std::cout << "Key found: " << foundKey << "\nDecrypted text: -" << decryptedText << "-" << std::endl;
         } else {
@@ -366,6 +281,14 @@ int main(int argc, char* argv[]) {
         std::cout << "Execution time: " << duration.count() << " seconds" << std::endl;
     }
 
-    MPI_Finalize();
+    printLoadReport(comm, load);
+
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    int status = runDriver<DesCipher>(MPI_COMM_WORLD, argc, argv);
+    MPI_Finalize();
+    return status;
+}
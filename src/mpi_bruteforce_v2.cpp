@@ -4,6 +4,8 @@
  *
  * This program uses MPI for distributed memory parallelism and OpenMP for shared memory parallelism.
  * It includes inter-process communication to allow early exit when a key is found.
+ * The searches are templates over a cipher policy (cipher_policy.h), instantiated with DES, or
+ * with 40-bit RC4 for `--mode rc4-40`.
  *
  * @note Compile using Open MPI, OpenMP, and OpenSSL libraries:
  * mpic++ -fopenmp -O3 -march=native -o mpi_bruteforce_v2 mpi_bruteforce_v2.cpp -lssl -lcrypto
@@ -17,13 +19,25 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
-#include <openssl/des.h>
 #include <mpi.h>
 #include <omp.h>
 #include <chrono>
 #include <algorithm>
 #include <cctype>
 #include <locale>
+#include <vector>
+
+#include "block_hash.h"
+#include "cipher_policy.h"
+#include "coverage.h"
+#include "driver_options.h"
+#include "hdr_histogram.h"
+#include "job_descriptor.h"
+#include "load_report.h"
+#include "metrics.h"
+#include "solved_cache.h"
+#include "stage_cycles.h"
+#include "trace.h"
 
 #define DEBUG 0  // Set to 1 to enable debug messages
 
@@ -44,320 +58,1081 @@ static inline void trim(std::string &s) {
 }
 
 /**
- * @brief Encrypts the plaintext using DES with the specified key.
+ * @brief Reads a search phrase file, joining its non-empty lines with single spaces.
  *
- * @param key The 8-byte DES key.
- * @param plaintext The input data to encrypt.
- * @param ciphertext The buffer to store encrypted data.
- * @param len Length of the plaintext.
+ * @return false If the file cannot be opened.
  */
-void encrypt(const unsigned char* key, const unsigned char* plaintext, unsigned char* ciphertext, int len) {
-    DES_cblock keyBlock;
-    DES_key_schedule keySchedule;
+static bool readPhrase(const std::string& path, std::string& phrase) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    bool firstLine = true;  // Flag to handle spacing correctly
+    while (std::getline(file, line)) {
+        trim(line);
+        if (!line.empty()) {
+            if (!firstLine) {
+                phrase += ' ';  // Add a space between lines
+            }
+            phrase += line;
+            firstLine = false;
+        }
+    }
+    return true;
+}
 
-    memcpy(keyBlock, key, 8);
+/**
+ * @brief Per-rank counters and histograms accumulated over all the searches of a run.
+ */
+struct SearchStats {
+    RankLoad load;
+    uint64_t candidates = 0;  ///< Keys that passed the first filter.
+    uint64_t rejected = 0;    ///< Candidates that failed the full predicate.
+    uint64_t stageCycles[NUM_STAGES] = {};
+    HdrHistogram chunkTimes;
+    HdrHistogram stopLatency;
+};
 
-    // Suppress deprecated warnings for OpenSSL DES functions
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+typedef std::chrono::duration<double> Seconds;
 
-    // Set the key parity bits
-    DES_set_odd_parity(&keyBlock);
+/**
+ * @brief Receives the found-key messages waiting on tag 0.
+ *
+ * Messages are {key, time found on process 0's clock, job or target index}.
+ *
+ * @param comm The communicator of the search.
+ * @param stats Statistics charged with the polling cycles.
+ * @param handle Called with each message.
+ */
+template <typename Handler>
+static inline void pollFound(MPI_Comm comm, SearchStats& stats, Handler handle) {
+    trace::Scope pollScope(trace::POLL);
+    uint64_t pollStart = STAGE_CYCLES ? readCycles() : 0;
+    int flag = 0;
+    MPI_Status status;
+    while (true) {
+        MPI_Iprobe(MPI_ANY_SOURCE, 0, comm, &flag, &status);
+        if (!flag) {
+            break;
+        }
+        uint64_t foundMessage[3];
+        MPI_Recv(foundMessage, 3, MPI_UINT64_T, status.MPI_SOURCE, 0, comm, MPI_STATUS_IGNORE);
+        handle(foundMessage);
+    }
+    if (STAGE_CYCLES) {
+        stats.stageCycles[STAGE_POLL] += readCycles() - pollStart;
+    }
+}
+
+/**
+ * @brief Sends a found-key message to every other process.
+ */
+static inline void announceFound(MPI_Comm comm, uint64_t key, uint64_t foundAt, uint64_t index) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+    uint64_t foundMessage[3] = {key, foundAt, index};
+    for (int i = 0; i < numProcesses; ++i) {
+        if (i != processId) {
+            MPI_Send(foundMessage, 3, MPI_UINT64_T, i, 0, comm);
+        }
+    }
+}
 
-    // Use DES_set_key_unchecked to set the key schedule
-    DES_set_key_unchecked(&keyBlock, &keySchedule);
+/**
+ * @brief Records chunk timing and load after a chunk; returns when it finished.
+ */
+static inline std::chrono::high_resolution_clock::time_point
+finishChunk(std::chrono::high_resolution_clock::time_point chunkStart, uint64_t keysTested, SearchStats& stats,
+            MetricsReporter& metrics) {
+    auto chunkFinish = std::chrono::high_resolution_clock::now();
+    stats.load.busySeconds += Seconds(chunkFinish - chunkStart).count();
+    uint64_t chunkMicros = std::chrono::duration_cast<std::chrono::microseconds>(chunkFinish - chunkStart).count();
+    stats.chunkTimes.record(chunkMicros);
+    metrics.observe(LATENCY_CHUNK, chunkMicros);
+    stats.load.keysTested += keysTested;
+    return chunkFinish;
+}
 
-    for (int i = 0; i < len; i += 8) {
-        DES_ecb_encrypt((const_DES_cblock*)(plaintext + i), (DES_cblock*)(ciphertext + i), &keySchedule, DES_ENCRYPT);
+/**
+ * @brief Waits at the end-of-search barrier, charging the wait as idle time.
+ */
+static inline void endSearch(MPI_Comm comm, SearchStats& stats) {
+    auto searchEnd = std::chrono::high_resolution_clock::now();
+    {
+        trace::Scope idleScope(trace::IDLE);
+        MPI_Barrier(comm);  // Ensure all processes have finished
     }
+    stats.load.idleSeconds += Seconds(std::chrono::high_resolution_clock::now() - searchEnd).count();
+}
 
-#pragma GCC diagnostic pop  // Restore the previous warning settings
+/**
+ * @brief Checks a key that passed the filter against the other pairs of its job.
+ *
+ * @param schedule The key's schedule.
+ * @param checks The other pairs, most selective first.
+ * @param decrypted Scratch space of at least the largest window of `checks`.
+ * @return true If every pair matches.
+ */
+template <typename Cipher>
+static inline bool confirmPairs(typename Cipher::Schedule& schedule, const std::vector<JobDescriptor>& checks,
+                                unsigned char* decrypted) {
+    for (const JobDescriptor& check : checks) {
+        Cipher::decryptBlocks(schedule, check.ciphertext.data(), decrypted, check.ciphertext.size(),
+                              check.windowOffset);
+        check.unchain(decrypted);
+        if (!check.matches(decrypted)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
- * @brief Decrypts the ciphertext using DES with the specified key.
+ * @brief Searches the chunks of this rank for the key of one job.
  *
- * @param key The 8-byte DES key.
- * @param ciphertext The encrypted data.
- * @param plaintext The buffer to store decrypted data.
- * @param len Length of the ciphertext.
+ * The rank that finds the key tells every other rank; the message carries the job index,
+ * so messages left over from an earlier job of a corpus are dropped. Ends with a barrier,
+ * so every rank has stopped searching the job when this returns.
+ *
+ * @param comm The communicator of the search.
+ * @param job The job to search: its pair is the filter every key is tested against.
+ * @param checks Further pairs of the job, tested in order on the keys that pass the filter;
+ *               the keys they reject are counted as rejected candidates.
+ * @param plan Assignment of the chunks to the ranks.
+ * @param cached Key ranges already searched in an earlier run; chunks inside them are skipped.
+ * @param chunkIndex In: first chunk of this rank to search; out: chunks of this rank completed.
+ * @param jobIndex Index of the job within the run.
+ * @param deadlineNs Local steady-clock time at which to stop (UINT64_MAX for none).
+ * @param clockOffset Offset mapping this rank's clock onto process 0's.
+ * @param stats Accumulated statistics.
+ * @param metrics Live metrics reporter.
+ * @param globalFoundKey Set to the key when it is found.
+ * @param deadlineReached Set when the search stopped at the deadline.
+ * @return true If some rank found the key.
  */
-void decrypt(const unsigned char* key, const unsigned char* ciphertext, unsigned char* plaintext, int len) {
-    DES_cblock keyBlock;
-    DES_key_schedule keySchedule;
+template <typename Cipher>
+bool searchJob(MPI_Comm comm, const JobDescriptor& job, const std::vector<JobDescriptor>& checks,
+               const ChunkPlan& plan, const KeyRanges& cached,
+               uint64_t& chunkIndex, uint64_t jobIndex, uint64_t deadlineNs, int64_t clockOffset, SearchStats& stats,
+               MetricsReporter& metrics, uint64_t& globalFoundKey, bool& deadlineReached) {
+    int processId;
+    MPI_Comm_rank(comm, &processId);
 
-    memcpy(keyBlock, key, 8);
+    const unsigned char* ciphertext = job.ciphertext.data();
+    int windowLength = job.ciphertext.size();
+    uint64_t numChunks = plan.chunksOf(processId);
+    size_t checkWindow = 0;
+    for (const JobDescriptor& check : checks) {
+        checkWindow = std::max(checkWindow, check.ciphertext.size());
+    }
+
+    uint64_t foundKey = 0;
+    bool keyFound = false;
+    bool globalKeyFound = false;
+    uint64_t foundAt = 0;  // When the key was found, on process 0's clock (ns)
+    deadlineReached = false;
+
+    while (chunkIndex < numChunks && !globalKeyFound && !deadlineReached) {
+        uint64_t currentKey, chunkEnd;
+        plan.chunk(processId, chunkIndex, currentKey, chunkEnd);
+        if (rangesContain(cached, currentKey, chunkEnd)) {
+            ++chunkIndex;
+            continue;
+        }
+        trace::instant(trace::LEASE, currentKey);
+        uint64_t keysTested = 0;
+        uint64_t candidates = 0;
+        uint64_t rejected = 0;
+        auto chunkStart = std::chrono::high_resolution_clock::now();
+
+        // Brute-force key search with OpenMP
+#pragma omp parallel shared(foundKey, keyFound, deadlineReached) reduction(+:keysTested, candidates, rejected)
+        {
+            // Each thread has its own local variables
+            unsigned char localKeyArray[Cipher::kBatch * Cipher::kKeyBytes];
+            unsigned char localDecrypted[windowLength];
+            std::vector<unsigned char> localConfirm(checkWindow);
+            typename Cipher::Schedule localSchedules[Cipher::kBatch];
+            StageTimer timer;
+
+            // Loop over the keys assigned to this chunk, Cipher::kBatch keys per step
+            {
+                trace::Scope chunkScope(trace::CHUNK, currentKey);
+#pragma omp for schedule(dynamic, 1024 / Cipher::kBatch) nowait
+                for (uint64_t batch = currentKey; batch < chunkEnd; batch += Cipher::kBatch) {
+                    // Early exit if key is found or time is up
+                    if (keyFound || deadlineReached) {
+                        continue;
+                    }
+
+                    // Check the deadline every 1024 keys so that it cuts the chunk short
+                    if ((batch & 1023) < Cipher::kBatch && trace::now() >= deadlineNs) {
+                        deadlineReached = true;
+                        continue;
+                    }
+
+                    size_t count = std::min<uint64_t>(Cipher::kBatch, chunkEnd - batch);
+                    keysTested += count;
+                    timer.begin();
+
+                    // Convert the keys to key arrays
+                    for (size_t b = 0; b < count; ++b) {
+                        Cipher::keyFromInteger(batch + b, localKeyArray + b * Cipher::kKeyBytes);
+                    }
+                    timer.lap(STAGE_KEYGEN);
+
+                    Cipher::setKeys(localKeyArray, localSchedules, count);
+                    timer.lap(STAGE_KEY_SCHEDULE);
 
-    // Suppress deprecated warnings for OpenSSL DES functions
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+                    for (size_t b = 0; b < count; ++b) {
+                        // Decrypt the ciphertext
+                        Cipher::decryptBlocks(localSchedules[b], ciphertext, localDecrypted, windowLength,
+                                              job.windowOffset);
+                        job.unchain(localDecrypted);
+                        timer.lap(STAGE_ROUNDS);
 
-    // Set the key parity bits
-    DES_set_odd_parity(&keyBlock);
+                        // Check if decrypted text contains the search phrase
+                        bool match = job.matches(localDecrypted);
+                        timer.lap(STAGE_PREDICATE);
+                        if (match) {
+                            ++candidates;
+                            if (!confirmPairs<Cipher>(localSchedules[b], checks, localConfirm.data())) {
+                                ++rejected;
+                                continue;
+                            }
 
-    // Use DES_set_key_unchecked to set the key schedule
-    DES_set_key_unchecked(&keyBlock, &keySchedule);
+                            // Critical section to update shared variables
+#pragma omp critical
+                            {
+                                if (!keyFound) {
+                                    foundKey = batch + b;
+                                    keyFound = true;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (STAGE_CYCLES) {
+#pragma omp critical
+                timer.mergeInto(stats.stageCycles);
+            }
+
+            // Wait for the slowest thread before the next chunk
+            trace::Scope barrierScope(trace::BARRIER, currentKey);
+#pragma omp barrier
+        }  // End of OpenMP parallel region
 
-    for (int i = 0; i < len; i += 8) {
-        DES_ecb_encrypt((const_DES_cblock*)(ciphertext + i), (DES_cblock*)(plaintext + i), &keySchedule, DES_DECRYPT);
+        auto chunkFinish = finishChunk(chunkStart, keysTested, stats, metrics);
+        stats.candidates += candidates;
+        stats.rejected += rejected;
+        if (!keyFound && !deadlineReached) {
+            ++stats.load.chunksCompleted;
+            ++chunkIndex;
+        }
+
+        // Check if keyFound
+        if (keyFound) {
+            // Send foundKey and the time it was found to all other processes
+            foundAt = trace::now() + clockOffset;
+            announceFound(comm, foundKey, foundAt, jobIndex);
+            globalFoundKey = foundKey;
+            globalKeyFound = true;
+        } else {
+            // Non-blocking probe for messages from other processes
+            pollFound(comm, stats, [&](const uint64_t* foundMessage) {
+                if (foundMessage[2] == jobIndex) {
+                    foundAt = foundMessage[1];
+                    globalFoundKey = foundMessage[0];
+                    globalKeyFound = true;
+                }
+            });
+        }
+
+        metrics.update(stats.load.keysTested, stats.candidates, stats.rejected);
+        stats.load.idleSeconds += Seconds(std::chrono::high_resolution_clock::now() - chunkFinish).count();
+    }
+
+    if (globalKeyFound) {
+        int64_t stopMicros = (static_cast<int64_t>(trace::now() + clockOffset) - static_cast<int64_t>(foundAt)) / 1000;
+        stats.stopLatency.record(std::max<int64_t>(stopMicros, 0));
+        metrics.observe(LATENCY_STOP, std::max<int64_t>(stopMicros, 0));
     }
 
-#pragma GCC diagnostic pop  // Restore the previous warning settings
+    endSearch(comm, stats);
+    return globalKeyFound;
 }
 
 /**
- * @brief Converts a 64-bit integer to an 8-byte key.
+ * @brief Sweeps this rank's chunks once, testing every target at each key.
  *
- * @param key The 64-bit integer key.
- * @param keyArray The buffer to store the converted 8-byte key.
+ * All targets share the cipher input of one aligned block (its plaintext, XORed with the
+ * previous ciphertext block in CBC mode), so a key costs a single block encryption and a
+ * BlockHash probe whatever the number of targets; only a hit decrypts that target's window
+ * and checks the full predicate. Each solved target is announced to
+ * every rank, and the sweep ends once all targets are solved. Ends with a barrier.
+ *
+ * @param comm The communicator of the search.
+ * @param targets The jobs to solve.
+ * @param known The cipher input known in every target (see JobDescriptor::knownInput).
+ * @param knownOffset Offset of the known block in the full ciphertexts (used by stream ciphers).
+ * @param plan Assignment of the chunks to the ranks.
+ * @param chunkIndex Out: chunks of this rank completed.
+ * @param deadlineNs Local steady-clock time at which to stop (UINT64_MAX for none).
+ * @param clockOffset Offset mapping this rank's clock onto process 0's.
+ * @param stats Accumulated statistics.
+ * @param metrics Live metrics reporter.
+ * @param solved Set to 1 for every solved target.
+ * @param keys The key of every solved target.
+ * @param deadlineReached Set when the sweep stopped at the deadline.
  */
-void longToKey(uint64_t key, unsigned char* keyArray) {
-    for (int i = 0; i < 8; ++i) {
-        keyArray[7 - i] = (key >> (i * 8)) & 0xFF;
+template <typename Cipher>
+void sweepTargets(MPI_Comm comm, const std::vector<JobDescriptor>& targets, const unsigned char* known,
+                  size_t knownOffset, const ChunkPlan& plan, uint64_t& chunkIndex, uint64_t deadlineNs, int64_t clockOffset,
+                  SearchStats& stats, MetricsReporter& metrics, std::vector<char>& solved, std::vector<uint64_t>& keys,
+                  bool& deadlineReached) {
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    // Index the targets by the ciphertext of their known block
+    std::vector<uint64_t> blocks;
+    size_t maxWindow = 0;
+    for (const JobDescriptor& target : targets) {
+        size_t offset = 0;
+        target.knownBlock(offset);
+        blocks.push_back(loadBlock(target.ciphertext.data() + offset));
+        maxWindow = std::max(maxWindow, target.ciphertext.size());
+    }
+    BlockHash targetHash(blocks);
+
+    size_t numTargets = targets.size();
+    size_t solvedCount = 0;
+    solved.assign(numTargets, 0);
+    keys.assign(numTargets, 0);
+    uint64_t numChunks = plan.chunksOf(processId);
+    chunkIndex = 0;
+    deadlineReached = false;
+
+    while (chunkIndex < numChunks && solvedCount < numTargets && !deadlineReached) {
+        uint64_t currentKey, chunkEnd;
+        plan.chunk(processId, chunkIndex, currentKey, chunkEnd);
+        trace::instant(trace::LEASE, currentKey);
+        uint64_t keysTested = 0;
+        uint64_t candidates = 0;
+        uint64_t rejected = 0;
+        std::vector<uint32_t> newlySolved;
+        auto chunkStart = std::chrono::high_resolution_clock::now();
+
+#pragma omp parallel shared(solved, keys, solvedCount, deadlineReached) reduction(+:keysTested, candidates, rejected)
+        {
+            unsigned char localKeyArray[Cipher::kBatch * Cipher::kKeyBytes];
+            unsigned char localBlock[8];
+            std::vector<unsigned char> localDecrypted(maxWindow);
+            typename Cipher::Schedule localSchedules[Cipher::kBatch];
+            StageTimer timer;
+
+            {
+                trace::Scope chunkScope(trace::CHUNK, currentKey);
+#pragma omp for schedule(dynamic, 1024 / Cipher::kBatch) nowait
+                for (uint64_t batch = currentKey; batch < chunkEnd; batch += Cipher::kBatch) {
+                    if (solvedCount == numTargets || deadlineReached) {
+                        continue;
+                    }
+                    if ((batch & 1023) < Cipher::kBatch && trace::now() >= deadlineNs) {
+                        deadlineReached = true;
+                        continue;
+                    }
+
+                    size_t count = std::min<uint64_t>(Cipher::kBatch, chunkEnd - batch);
+                    keysTested += count;
+                    timer.begin();
+                    for (size_t b = 0; b < count; ++b) {
+                        Cipher::keyFromInteger(batch + b, localKeyArray + b * Cipher::kKeyBytes);
+                    }
+                    timer.lap(STAGE_KEYGEN);
+                    Cipher::setKeys(localKeyArray, localSchedules, count);
+                    timer.lap(STAGE_KEY_SCHEDULE);
+                    for (size_t b = 0; b < count; ++b) {
+                        uint64_t key = batch + b;
+                        typename Cipher::Schedule& localSchedule = localSchedules[b];
+                        Cipher::encryptBlock(localSchedule, known, localBlock, knownOffset);
+                        timer.lap(STAGE_ROUNDS);
+                        uint32_t t = targetHash.find(loadBlock(localBlock));
+                        timer.lap(STAGE_PREDICATE);
+
+                        // Confirm every target whose known block matched with its full predicate
+                        for (; t != BlockHash::kNone; t = targetHash.next(t)) {
+                            ++candidates;
+                            Cipher::decryptBlocks(localSchedule, targets[t].ciphertext.data(), localDecrypted.data(),
+                                                  targets[t].ciphertext.size(), targets[t].windowOffset);
+                            targets[t].unchain(localDecrypted.data());
+                            if (!targets[t].matches(localDecrypted.data())) {
+                                ++rejected;
+                                continue;
+                            }
+#pragma omp critical
+                            {
+                                if (!solved[t]) {
+                                    solved[t] = 1;
+                                    keys[t] = key;
+                                    ++solvedCount;
+                                    newlySolved.push_back(t);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (STAGE_CYCLES) {
+#pragma omp critical
+                timer.mergeInto(stats.stageCycles);
+            }
+
+            trace::Scope barrierScope(trace::BARRIER, currentKey);
+#pragma omp barrier
+        }  // End of OpenMP parallel region
+
+        auto chunkFinish = finishChunk(chunkStart, keysTested, stats, metrics);
+        stats.candidates += candidates;
+        stats.rejected += rejected;
+        if (!deadlineReached) {
+            ++stats.load.chunksCompleted;
+            ++chunkIndex;
+        }
+
+        // Share the targets solved here and collect those solved elsewhere
+        uint64_t foundAt = trace::now() + clockOffset;
+        for (uint32_t t : newlySolved) {
+            announceFound(comm, keys[t], foundAt, t);
+        }
+        pollFound(comm, stats, [&](const uint64_t* foundMessage) {
+            uint64_t t = foundMessage[2];
+            if (t < numTargets && !solved[t]) {
+                solved[t] = 1;
+                keys[t] = foundMessage[0];
+                ++solvedCount;
+            }
+        });
+
+        metrics.update(stats.load.keysTested, stats.candidates, stats.rejected);
+        stats.load.idleSeconds += Seconds(std::chrono::high_resolution_clock::now() - chunkFinish).count();
     }
+
+    endSearch(comm, stats);
 }
 
 /**
- * @brief Main function that orchestrates the MPI and OpenMP brute-force key search.
+ * @brief Sets the engine and key space of a job built for the cipher of the run.
  */
-int main(int argc, char* argv[]) {
-    // Initialize MPI environment
-    MPI_Init(&argc, &argv);
+template <typename Cipher>
+static void bindCipher(JobDescriptor& job, const DriverOptions& options) {
+    if (Cipher::kStream) {
+        job.engine = options.engine;
+    }
+    job.keyspace = Cipher::kKeySpace;
+}
 
-    int numProcesses, processId;
-    MPI_Comm comm = MPI_COMM_WORLD;
+/**
+ * @brief Loads a ciphertext file into a job for the cipher of the run (see loadCiphertextJob).
+ */
+template <typename Cipher>
+static bool loadJob(const std::string& path, const DriverOptions& options, const std::string& searchPhrase,
+                    long cribOffset, JobDescriptor& job, std::vector<unsigned char>& loaded, std::string& error) {
+    if (!loadCiphertextJob(path, options.inputFormat, searchPhrase, cribOffset, job, loaded, error, options.cbcIv(),
+                           Cipher::kStream ? 1 : Cipher::kBlockBytes)) {
+        return false;
+    }
+    bindCipher<Cipher>(job, options);
+    return true;
+}
 
+/**
+ * @brief Prints a found key and the text it decrypts (process 0).
+ *
+ * @param key The key.
+ * @param job The job the ciphertext belongs to (for its mode and IV).
+ * @param ciphertext Ciphertext to decrypt for display.
+ * @param stats Statistics charged with the verification cycles.
+ */
+template <typename Cipher>
+static void printFoundKey(uint64_t key, const JobDescriptor& job, const std::vector<unsigned char>& ciphertext,
+                          SearchStats& stats) {
+    trace::Scope verifyScope(trace::VERIFY, key);
+    uint64_t verifyStart = STAGE_CYCLES ? readCycles() : 0;
+    int paddedLength = ciphertext.size();
+    unsigned char decryptedText[paddedLength + 1];
+    unsigned char foundKeyArray[Cipher::kKeyBytes];
+    Cipher::keyFromInteger(key, foundKeyArray);
+    Cipher::decrypt(foundKeyArray, ciphertext.data(), decryptedText, paddedLength, job.ivFor(paddedLength),
+                    job.offsetFor(paddedLength));
+    if (STAGE_CYCLES) {
+        stats.stageCycles[STAGE_VERIFY] += readCycles() - verifyStart;
+    }
+    decryptedText[paddedLength] = '\0';
+    std::cout << "Key found: " << key << "\nDecrypted text: -" << decryptedText << "-" << std::endl;
+}
+
+/**
+ * @brief Searches every ciphertext of a corpus as its own job, one after the other.
+ *
+ * Process 0 streams the corpus and loads the next ciphertext while the ranks search the
+ * current one, so a new job starts as soon as the previous one is solved, without a new
+ * `mpirun`. The time from a job being read to its result is its turnaround. With a cache,
+ * process 0 answers the jobs it already solved (or searched in full) on its own, and the
+ * ranks skip the key ranges an earlier run searched.
+ *
+ * @param cache The solved cache (process 0); used when `--cache` is given.
+ * @param turnaround Job turnaround times (us), recorded on process 0.
+ * @param deadlineReached Set when the run stopped at the deadline.
+ */
+template <typename Cipher>
+void runCorpusJobs(MPI_Comm comm, const DriverOptions& options, const std::string& searchPhrase, uint64_t deadlineNs,
+                   int64_t clockOffset, SearchStats& stats, MetricsReporter& metrics, SolvedCache& cache,
+                   HdrHistogram& turnaround, bool& deadlineReached) {
+    typedef std::chrono::high_resolution_clock Clock;
+    int numProcesses, processId;
     MPI_Comm_size(comm, &numProcesses);
     MPI_Comm_rank(comm, &processId);
 
-    std::string plaintext;
-    std::string searchPhrase;
-    uint64_t encryptionKey;
+    // A loaded job waiting for its turn (process 0)
+    struct PendingJob {
+        JobDescriptor job;
+        std::vector<unsigned char> ciphertext;
+        std::string path;
+        Clock::time_point readAt;
+    };
 
-    // Process 0 reads the input files and broadcasts the data
+    CorpusReader reader;
+    auto loadNext = [&](PendingJob& pending) {
+        CorpusEntry entry;
+        while (reader.next(entry)) {
+            std::string error;
+            if (loadJob<Cipher>(entry.path, options, searchPhrase, entry.cribOffset, pending.job, pending.ciphertext,
+                                error)) {
+                pending.path = entry.path;
+                pending.readAt = Clock::now();
+                return true;
+            }
+            std::cerr << entry.path << ": " << error << " Skipped." << std::endl;
+        }
+        return false;
+    };
+
+    PendingJob current, next;
+    bool haveNext = false;
     if (processId == 0) {
-        if (argc != 4) {
-            std::cerr << "Usage: " << argv[0] << " <input_file> <encryption_key> <search_phrase_file>" << std::endl;
+        std::string error;
+        if (!reader.open(options.corpus, options.cribOffset, error)) {
+            std::cerr << error << std::endl;
             MPI_Abort(comm, 1);
         }
+        haveNext = loadNext(next);
+    }
+
+    uint64_t jobs = 0, solvedJobs = 0;
+    auto report = [&](bool found, uint64_t key) {
+        uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - current.readAt).count();
+        turnaround.record(micros);
+        metrics.observe(LATENCY_TURNAROUND, micros);
+        std::cout << "Job " << jobs++ << ": " << current.path << std::endl;
+        if (found) {
+            ++solvedJobs;
+            printFoundKey<Cipher>(key, current.job, current.ciphertext, stats);
+        } else {
+            std::cout << "Key not found in the specified range." << std::endl;
+        }
+    };
+
+    bool useCache = !options.cacheDir.empty();
+    deadlineReached = false;
+    for (uint64_t jobIndex = 0;; ++jobIndex) {
+        // Process 0 alone decides whether there is another job; an empty job ends the stream
+        JobDescriptor job;
+        CacheEntry cached;
+        std::string digest;
+        if (processId == 0) {
+            while (haveNext && !deadlineReached) {
+                std::swap(current, next);
+                if (useCache) {
+                    digest = jobDigest(current.job);
+                    cached = cache.lookup(digest);
+                }
+                if (!cached.solved && !cached.exhausted(current.job.keyspace)) {
+                    job = current.job;
+                    break;
+                }
+                report(cached.solved, cached.key);
+                std::cout << "Answered from the cache." << std::endl;
+                haveNext = loadNext(next);
+            }
+        }
+        broadcastJob(comm, job);
+        if (job.ciphertext.empty()) {
+            break;
+        }
+        if (useCache) {
+            shareCacheEntry(comm, cached);
+        }
+        if (processId == 0) {
+            haveNext = loadNext(next);
+        }
+
+        ChunkPlan plan = {options.prior, job.keyspace, job.chunkSize, numProcesses};
+        uint64_t chunkIndex = 0;
+        uint64_t foundKey = 0;
+        metrics.beginJob(stats.load.keysTested, static_cast<double>(job.keyspace));
+        bool found = searchJob<Cipher>(comm, job, std::vector<JobDescriptor>(), plan, cached.covered, chunkIndex,
+                                       jobIndex, deadlineNs, clockOffset, stats, metrics, foundKey, deadlineReached);
+        if (useCache) {
+            recordSearch(comm, cache, digest, plan, chunkIndex, found, foundKey);
+        }
+
+        if (processId == 0) {
+            report(found, foundKey);
+        }
+    }
+
+    if (processId == 0) {
+        std::cout << "Corpus: " << solvedJobs << " of " << jobs << " jobs solved" << std::endl;
+        if (haveNext) {
+            std::cout << "The deadline was reached before the end of the corpus." << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Solves every ciphertext of a corpus in one multi-target sweep of the key space.
+ *
+ * Process 0 reads the whole corpus and keeps the ciphertexts whose crib covers an aligned
+ * block with the same plaintext as the first one; the others are reported as needing the
+ * jobs mode. The kept targets are broadcast one descriptor at a time. With a cache, the
+ * targets it already answers are reported without being swept; the sweep's result for
+ * every other target is recorded.
+ *
+ * @param cache The solved cache (process 0); used when `--cache` is given.
+ * @param deadlineReached Set when the sweep stopped at the deadline.
+ */
+template <typename Cipher>
+void runCorpusSweep(MPI_Comm comm, const DriverOptions& options, const std::string& searchPhrase, uint64_t deadlineNs,
+                    int64_t clockOffset, SearchStats& stats, MetricsReporter& metrics, SolvedCache& cache,
+                    bool& deadlineReached) {
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
 
-        // Load plaintext from the file, skipping empty lines
-        std::ifstream inputFile(argv[1]);
-        if (!inputFile) {
-            std::cerr << "Failed to open input file." << std::endl;
+    std::vector<JobDescriptor> targets;
+    std::vector<std::vector<unsigned char>> ciphertexts;
+    std::vector<std::string> paths;
+    std::vector<std::string> digests;
+    std::string known;
+    size_t knownOffset = 0;
+    uint64_t cachedTargets = 0, cachedSolved = 0;
+    bool useCache = !options.cacheDir.empty();
+    if (processId == 0) {
+        CorpusReader reader;
+        std::string error;
+        if (!reader.open(options.corpus, options.cribOffset, error)) {
+            std::cerr << error << std::endl;
             MPI_Abort(comm, 1);
         }
+        CorpusEntry entry;
+        while (reader.next(entry)) {
+            JobDescriptor job;
+            std::vector<unsigned char> ciphertext;
+            size_t offset = 0;
+            if (!loadJob<Cipher>(entry.path, options, searchPhrase, entry.cribOffset, job, ciphertext, error)) {
+                std::cerr << entry.path << ": " << error << " Skipped." << std::endl;
+                continue;
+            }
+            if (!job.knownBlock(offset)) {
+                std::cerr << entry.path << ": the crib does not cover an aligned block; use --corpus-mode jobs."
+                          << " Skipped." << std::endl;
+                continue;
+            }
+            std::string block(8, '\0');
+            job.knownInput(offset, reinterpret_cast<unsigned char*>(&block[0]));
+            if (known.empty()) {
+                known = block;
+                knownOffset = job.windowOffset + offset;
+            } else if (block != known || (Cipher::kStream && job.windowOffset + offset != knownOffset)) {
+                std::cerr << entry.path << ": the known block differs from the other targets'; use --corpus-mode jobs."
+                          << " Skipped." << std::endl;
+                continue;
+            }
+            std::string digest = useCache ? jobDigest(job) : std::string();
+            CacheEntry cached = useCache ? cache.lookup(digest) : CacheEntry();
+            if (cached.solved || cached.exhausted(job.keyspace)) {
+                ++cachedTargets;
+                std::cout << "Cached target: " << entry.path << std::endl;
+                if (cached.solved) {
+                    ++cachedSolved;
+                    printFoundKey<Cipher>(cached.key, job, ciphertext, stats);
+                } else {
+                    std::cout << "Key not found in the specified range." << std::endl;
+                }
+                continue;
+            }
+            digests.push_back(digest);
+            targets.push_back(job);
+            ciphertexts.push_back(ciphertext);
+            paths.push_back(entry.path);
+        }
+        std::cout << "Sweeping " << targets.size() << " targets" << std::endl;
+    }
 
-        std::string line;
-        bool firstLine = true; // Flag to handle spacing correctly
-        while (std::getline(inputFile, line)) {
-            trim(line);
-            if (!line.empty()) {
-                if (!firstLine) {
-                    plaintext += ' ';  // Add a space between lines
+    uint64_t numTargets = targets.size();
+    MPI_Bcast(&numTargets, 1, MPI_UINT64_T, 0, comm);
+    targets.resize(numTargets);
+    for (JobDescriptor& target : targets) {
+        broadcastJob(comm, target);
+    }
+    if (numTargets == 0) {
+        if (processId == 0 && cachedTargets > 0) {
+            std::cout << "Corpus: " << cachedSolved << " of " << cachedTargets << " targets solved" << std::endl;
+        }
+        return;
+    }
+    if (processId != 0) {
+        size_t offset = 0;
+        targets[0].knownBlock(offset);
+        known.assign(8, '\0');
+        targets[0].knownInput(offset, reinterpret_cast<unsigned char*>(&known[0]));
+        knownOffset = targets[0].windowOffset + offset;
+    }
+
+    ChunkPlan plan = {options.prior, targets[0].keyspace, targets[0].chunkSize, numProcesses};
+    uint64_t chunkIndex = 0;
+    std::vector<char> solved;
+    std::vector<uint64_t> keys;
+    sweepTargets<Cipher>(comm, targets, reinterpret_cast<const unsigned char*>(known.data()), knownOffset, plan,
+                         chunkIndex, deadlineNs, clockOffset, stats, metrics, solved, keys, deadlineReached);
+    if (useCache) {
+        std::vector<uint64_t> completed = gatherCompleted(comm, plan, chunkIndex);
+        if (processId == 0) {
+            KeyRanges covered = completedRanges(plan, completed);
+            for (size_t t = 0; t < numTargets; ++t) {
+                if (!(solved[t] ? cache.recordSolved(digests[t], keys[t]) : cache.recordCovered(digests[t], covered))) {
+                    std::cerr << "Failed to update the solved cache" << std::endl;
+                    break;
                 }
-                plaintext += line;
-                firstLine = false;
             }
         }
-        inputFile.close();
+    }
+
+    if (processId == 0) {
+        uint64_t solvedTargets = cachedSolved;
+        for (size_t t = 0; t < numTargets; ++t) {
+            std::cout << "Target " << t << ": " << paths[t] << std::endl;
+            if (solved[t]) {
+                ++solvedTargets;
+                printFoundKey<Cipher>(keys[t], targets[t], ciphertexts[t], stats);
+            } else {
+                std::cout << "Key not found in the specified range." << std::endl;
+            }
+        }
+        std::cout << "Corpus: " << solvedTargets << " of " << numTargets + cachedTargets << " targets solved"
+                  << std::endl;
+    }
+}
 
-        // Load the search phrase from the file, skipping empty lines
-        std::ifstream searchPhraseFile(argv[3]);
-        if (!searchPhraseFile) {
-            std::cerr << "Failed to open search phrase file." << std::endl;
+/**
+ * @brief Runs the driver with the given cipher: orchestrates the MPI and OpenMP brute-force key search.
+ *
+ * @return Process exit status.
+ */
+template <typename Cipher>
+static int runDriver(MPI_Comm comm, int argc, char* argv[]) {
+    int numProcesses, processId;
+
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    std::string plaintext;
+    std::string searchPhrase;
+    uint64_t encryptionKey = 0;
+
+    // Every process parses the command line so that all of them see the same options
+    DriverOptions options;
+    std::string optionsError;
+    bool optionsValid = parseDriverOptions(argc, argv, options, optionsError);
+    if (optionsValid && !options.traceFile.empty()) {
+        trace::enable();
+    }
+
+    // Process 0 reads the input files and broadcasts the data
+    if (processId == 0) {
+        if (!optionsValid) {
+            std::cerr << optionsError << std::endl;
+            printUsage(argv[0]);
             MPI_Abort(comm, 1);
         }
 
-        std::string searchLine;
-        firstLine = true; // Reset flag for search phrase
-        while (std::getline(searchPhraseFile, searchLine)) {
-            trim(searchLine);
-            if (!searchLine.empty()) {
-                if (!firstLine) {
-                    searchPhrase += ' ';  // Add a space between lines
+        // Load plaintext from the file, skipping empty lines (ciphertext formats are loaded below)
+        bool firstLine = true; // Flag to handle spacing correctly
+        if (options.inputFormat == FORMAT_PLAIN && options.corpus.empty()) {
+            std::ifstream inputFile(options.inputFile);
+            if (!inputFile) {
+                std::cerr << "Failed to open input file." << std::endl;
+                MPI_Abort(comm, 1);
+            }
+
+            std::string line;
+            while (std::getline(inputFile, line)) {
+                trim(line);
+                if (!line.empty()) {
+                    if (!firstLine) {
+                        plaintext += ' ';  // Add a space between lines
+                    }
+                    plaintext += line;
+                    firstLine = false;
                 }
-                searchPhrase += searchLine;
-                firstLine = false;
             }
+            inputFile.close();
+        }
+
+        // Load the search phrase from the file, skipping empty lines
+        if (!readPhrase(options.searchPhraseFile, searchPhrase)) {
+            std::cerr << "Failed to open search phrase file." << std::endl;
+            MPI_Abort(comm, 1);
         }
-        searchPhraseFile.close();
 
         // Convert encryption key to uint64_t
         try {
-            encryptionKey = std::stoull(argv[2]);
+            if (options.inputFormat == FORMAT_PLAIN) {
+                encryptionKey = std::stoull(options.encryptionKey);
+            }
         } catch (const std::invalid_argument& e) {
             std::cerr << "Invalid encryption key format." << std::endl;
             MPI_Abort(comm, 1);
         }
 
         // Print plaintext and search phrase
-        std::cout << "Plaintext: -" << plaintext << "-" << std::endl;
+        if (options.inputFormat == FORMAT_PLAIN) {
+            std::cout << "Plaintext: -" << plaintext << "-" << std::endl;
+        }
         std::cout << "Search phrase: -" << searchPhrase << "-" << std::endl;
-        std::cout << "Encryption key: " << encryptionKey << std::endl;
+        if (options.inputFormat == FORMAT_PLAIN) {
+            std::cout << "Encryption key: " << encryptionKey << std::endl;
+        }
     }
 
-    // Broadcast encryption key
-    MPI_Bcast(&encryptionKey, 1, MPI_UINT64_T, 0, comm);
+    // Process 0 encrypts the plaintext (or loads the ciphertext) and keeps the full ciphertext for
+    // verification; the other processes only receive the ciphertext blocks the predicate needs
+    JobDescriptor job;
+    std::vector<JobDescriptor> checks;  // Further pairs under the same key (--pair)
+    std::vector<unsigned char> fullCiphertext;
+    if (processId == 0 && options.inputFormat == FORMAT_PLAIN) {
+        // Ensure the plaintext length is a multiple of 8
+        int paddedLength = ((plaintext.size() + 7) / 8) * 8;
+        std::vector<unsigned char> plaintextBuffer(paddedLength, 0);
+        memcpy(plaintextBuffer.data(), plaintext.c_str(), plaintext.size());
 
-    // Broadcast plaintext
-    int plaintextLength;
-    if (processId == 0) {
-        plaintextLength = plaintext.size();
-    }
-    MPI_Bcast(&plaintextLength, 1, MPI_INT, 0, comm);
+        // Convert encryption key to the cipher's key bytes
+        unsigned char keyArray[Cipher::kKeyBytes];
+        Cipher::keyFromInteger(encryptionKey, keyArray);
 
-    if (processId != 0) {
-        plaintext.resize(plaintextLength);
-    }
-    MPI_Bcast(&plaintext[0], plaintextLength, MPI_CHAR, 0, comm);
+        // Encrypt the plaintext
+        fullCiphertext.resize(paddedLength);
+        Cipher::encrypt(keyArray, plaintextBuffer.data(), fullCiphertext.data(), paddedLength, options.cbcIv());
+        job = makeJob(fullCiphertext.data(), paddedLength, plaintext, searchPhrase, options.cbcIv());
+        bindCipher<Cipher>(job, options);
 
-    // Broadcast search phrase
-    int searchPhraseLength;
-    if (processId == 0) {
-        searchPhraseLength = searchPhrase.size();
-    }
-    MPI_Bcast(&searchPhraseLength, 1, MPI_INT, 0, comm);
+        if (!options.dumpCiphertext.empty() && !writeCiphertext(options.dumpCiphertext, fullCiphertext.data(), paddedLength)) {
+            std::cerr << "Failed to write ciphertext to " << options.dumpCiphertext << std::endl;
+            MPI_Abort(comm, 1);
+        }
+    } else if (processId == 0 && options.corpus.empty()) {
+        std::string loadError;
+        if (!loadJob<Cipher>(options.inputFile, options, searchPhrase, options.cribOffset, job, fullCiphertext,
+                             loadError)) {
+            std::cerr << loadError << std::endl;
+            MPI_Abort(comm, 1);
+        }
+        std::cout << "Ciphertext: " << job.cipherLength << " bytes, searching " << job.ciphertext.size()
+                  << " bytes at offset " << job.windowOffset << std::endl;
 
-    if (processId != 0) {
-        searchPhrase.resize(searchPhraseLength);
+        for (const ExtraPair& extra : options.pairs) {
+            std::string phrase;
+            JobDescriptor check;
+            std::vector<unsigned char> unused;
+            if (!readPhrase(extra.phraseFile, phrase)) {
+                std::cerr << "Failed to open search phrase file " << extra.phraseFile << std::endl;
+                MPI_Abort(comm, 1);
+            }
+            if (!loadJob<Cipher>(extra.cipherFile, options, phrase, extra.cribOffset, check, unused, loadError)) {
+                std::cerr << extra.cipherFile << ": " << loadError << std::endl;
+                MPI_Abort(comm, 1);
+            }
+            checks.push_back(check);
+        }
     }
-    MPI_Bcast(&searchPhrase[0], searchPhraseLength, MPI_CHAR, 0, comm);
-
-    // Ensure the plaintext length is a multiple of 8
-    int paddedLength = ((plaintext.size() + 7) / 8) * 8;
-    unsigned char* plaintextBuffer = new unsigned char[paddedLength];
-    memset(plaintextBuffer, 0, paddedLength);
-    memcpy(plaintextBuffer, plaintext.c_str(), plaintext.size());
 
-    // Convert encryption key to 8-byte DES key
-    unsigned char keyArray[8];
-    longToKey(encryptionKey, keyArray);
+    // Process 0 puts the most selective pair in the hot loop; the others confirm its survivors
+    JobDescriptor inputJob = job;  // The input's own pair, to print the text a found key decrypts
+    if (processId == 0 && !checks.empty()) {
+        std::vector<JobDescriptor> pairs(1, job);
+        pairs.insert(pairs.end(), checks.begin(), checks.end());
+        orderBySelectivity(pairs);
+        job = pairs[0];
+        checks.assign(pairs.begin() + 1, pairs.end());
+        std::cout << "Filtering on a " << job.ciphertext.size() << "-byte window (pass rate 2^"
+                  << std::log2(job.passRate()) << "), confirming with " << checks.size() << " more pair(s)"
+                  << std::endl;
+    }
+    if (options.corpus.empty()) {
+        broadcastJob(comm, job);
+        uint64_t numChecks = checks.size();
+        MPI_Bcast(&numChecks, 1, MPI_UINT64_T, 0, comm);
+        checks.resize(numChecks);
+        for (JobDescriptor& check : checks) {
+            broadcastJob(comm, check);
+        }
+    }
 
-    // Encrypt the plaintext
-    unsigned char* ciphertext = new unsigned char[paddedLength];
-    encrypt(keyArray, plaintextBuffer, ciphertext, paddedLength);
+    // Process 0 looks the job up in the solved cache and shares what it knows
+    SolvedCache cache;
+    CacheEntry cached;
+    std::string digest;
+    if (!options.cacheDir.empty()) {
+        if (processId == 0) {
+            std::string cacheError;
+            if (!cache.open(options.cacheDir, cacheError)) {
+                std::cerr << cacheError << std::endl;
+                MPI_Abort(comm, 1);
+            }
+            if (options.corpus.empty()) {
+                digest = jobDigest(job, checks);
+                cached = cache.lookup(digest);
+            }
+        }
+        if (options.corpus.empty()) {
+            shareCacheEntry(comm, cached);
+        }
+    }
 
-    // Define key space and range for each process
-    uint64_t upperBound = (1ULL << 56);  // 2^56 keys for DES
-    uint64_t keysPerProcess = upperBound / numProcesses;
-    uint64_t lowerBound = keysPerProcess * processId;
-    uint64_t upperBoundLocal = (processId == numProcesses - 1) ? upperBound : lowerBound + keysPerProcess;
+    // Define key space and the chunks each process searches, in the order of the prior
+    uint64_t upperBound = job.keyspace;  // 2^56 keys for DES, 2^40 for RC4-40
+    uint64_t chunkSize = job.chunkSize;
+    ChunkPlan plan = {options.prior, upperBound, chunkSize, numProcesses};
+    uint64_t chunkIndex = options.corpus.empty() ? resumeFromCheckpoint(comm, plan, options.checkpointFile) : 0;
+    uint64_t numChunks = plan.chunksOf(processId);
 
-    uint64_t foundKey = 0;
-    bool keyFound = false;
-    uint64_t globalFoundKey = 0;
-    bool globalKeyFound = false;
+    // Map this rank's clock onto process 0's so that stop latencies can be measured across ranks
+    int64_t clockOffset = trace::localClockOffset(comm);
 
     // Start timing
     MPI_Barrier(comm);  // Ensure all processes start at the same time
     auto start = std::chrono::high_resolution_clock::now();
 
-    std::cout << "Process " << processId << " searching keys " << lowerBound << " to " << upperBoundLocal - 1 << std::endl;
-    // Set the number of threads to 4 for OpenMP
-    omp_set_num_threads(4);
-
-    // Define chunk size
-    uint64_t chunkSize = 1000000; // Adjust as needed
-    uint64_t currentKey = lowerBound;
-
-    while (currentKey < upperBoundLocal && !globalKeyFound) {
-        uint64_t chunkEnd = std::min(currentKey + chunkSize, upperBoundLocal);
-
-        // Brute-force key search with OpenMP
-#pragma omp parallel shared(foundKey, keyFound)
-        {
-            // Each thread has its own local variables
-            unsigned char localKeyArray[8];
-            unsigned char localDecrypted[paddedLength + 1];
-
-            // Loop over keys assigned to this chunk
-#pragma omp for schedule(dynamic, 1024)
-            for (uint64_t key = currentKey; key < chunkEnd; ++key) {
-                // Early exit if key is found
-                if (keyFound) {
-                    continue;
-                }
+    // Process 0 fixes the deadline on its clock and every process maps it onto its own, so
+    // that all of them stop at the same moment without exchanging any message
+    uint64_t deadlineNs = UINT64_MAX;
+    bool deadlineReached = false;
+    if (options.deadlineSeconds > 0) {
+        uint64_t deadline = trace::now() + static_cast<uint64_t>(options.deadlineSeconds * 1e9);
+        MPI_Bcast(&deadline, 1, MPI_UINT64_T, 0, comm);
+        deadlineNs = deadline - clockOffset;
+    }
 
-                // Convert key to key array
-                longToKey(key, localKeyArray);
+    if (options.corpus.empty() && chunkIndex < numChunks) {
+        uint64_t firstKey, lastKey, unused;
+        plan.chunk(processId, chunkIndex, firstKey, unused);
+        plan.chunk(processId, numChunks - 1, unused, lastKey);
+        std::cout << "Process " << processId << " searching keys " << firstKey << " to " << lastKey - 1;
+        if (options.prior == PRIOR_LOW_FIRST) {
+            std::cout << " (chunks of " << chunkSize << " keys interleaved over " << numProcesses << " processes)";
+        }
+        std::cout << std::endl;
+    }
+    // Set the number of threads for OpenMP (4 unless --threads is given)
+    omp_set_num_threads(options.threads);
 
-                // Decrypt the ciphertext
-                decrypt(localKeyArray, ciphertext, localDecrypted, paddedLength);
-                localDecrypted[paddedLength] = '\0';  // Null-terminate
+    SearchStats stats;
+    MetricsReporter metrics(comm, static_cast<double>(upperBound), options.metricsPort, options.metricsSocket);
+    HdrHistogram turnaround;
 
-                // Check if decrypted text contains the search phrase
-                if (strstr(reinterpret_cast<char*>(localDecrypted), searchPhrase.c_str()) != nullptr) {
-                    // Critical section to update shared variables
-#pragma omp critical
-                    {
-                        if (!keyFound) {
-                            foundKey = key;
-                            keyFound = true;
-                        }
-                    }
-                }
+    if (!options.corpus.empty()) {
+        if (options.corpusMode == CORPUS_SWEEP) {
+            runCorpusSweep<Cipher>(comm, options, searchPhrase, deadlineNs, clockOffset, stats, metrics, cache,
+                           deadlineReached);
+        } else {
+            runCorpusJobs<Cipher>(comm, options, searchPhrase, deadlineNs, clockOffset, stats, metrics, cache, turnaround,
+                          deadlineReached);
+        }
+    } else {
+        uint64_t globalFoundKey = cached.key;
+        bool globalKeyFound = cached.solved;
+        bool answeredFromCache = cached.solved || cached.exhausted(upperBound);
+        if (!answeredFromCache) {
+            globalKeyFound = searchJob<Cipher>(comm, job, checks, plan, cached.covered, chunkIndex, 0, deadlineNs,
+                                               clockOffset, stats, metrics, globalFoundKey, deadlineReached);
+            if (!options.cacheDir.empty()) {
+                recordSearch(comm, cache, digest, plan, chunkIndex, globalKeyFound, globalFoundKey);
             }
-        }  // End of OpenMP parallel region
+        }
 
-        // Check if keyFound
-        if (keyFound) {
-            // Send foundKey to all other processes
-            for (int i = 0; i < numProcesses; ++i) {
-                if (i != processId) {
-                    MPI_Send(&foundKey, 1, MPI_UINT64_T, i, 0, comm);
-                }
+        // Process 0 handles the output
+        if (processId == 0) {
+            if (globalKeyFound) {
+                printFoundKey<Cipher>(globalFoundKey, inputJob, fullCiphertext, stats);
+            } else {
+                std::cout << "Key not found in the specified range." << std::endl;
             }
-            globalFoundKey = foundKey;
-            globalKeyFound = true;
-        } else {
-            // Non-blocking probe for messages from other processes
-            int flag = 0;
-            MPI_Status status;
-            while (true) {
-                MPI_Iprobe(MPI_ANY_SOURCE, 0, comm, &flag, &status);
-                if (flag) {
-                    uint64_t receivedKey;
-                    MPI_Recv(&receivedKey, 1, MPI_UINT64_T, status.MPI_SOURCE, 0, comm, MPI_STATUS_IGNORE);
-                    globalFoundKey = receivedKey;
-                    globalKeyFound = true;
-                    keyFound = true;
-                    foundKey = receivedKey;
-                } else {
-                    break;
-                }
+            if (answeredFromCache) {
+                std::cout << "Answered from the cache." << std::endl;
             }
         }
-
-        // Update currentKey
-        currentKey = chunkEnd;
     }
-
-    // End timing
-    MPI_Barrier(comm);  // Ensure all processes have finished
     auto end = std::chrono::high_resolution_clock::now();
+    metrics.finish(stats.load.keysTested, stats.candidates, stats.rejected);
 
-    // Process 0 handles the output
     if (processId == 0) {
-        if (globalFoundKey != 0) {
-            unsigned char decryptedText[paddedLength + 1];
-            unsigned char foundKeyArray[8];
-            longToKey(globalFoundKey, foundKeyArray);
-            decrypt(foundKeyArray, ciphertext, decryptedText, paddedLength);
-            decryptedText[paddedLength] = '\0';
-            std::cout << "Key found: " << globalFoundKey << "\nDecrypted text: -" << decryptedText << "-" << std::endl;
-        } else {
-            std::cout << "Key not found in the specified range." << std::endl;
-        }
-
         std::chrono::duration<double> duration = end - start;
         std::cout << "Execution time: " << duration.count() << " seconds" << std::endl;
+        if (deadlineReached) {
+            std::cout << "Deadline of " << options.deadlineSeconds << " seconds reached." << std::endl;
+        }
+    }
+    if (options.corpus.empty()) {
+        reportCoverage(comm, plan, chunkIndex, options.checkpointFile);
     }
+    printLoadReport(comm, stats.load);
+    printStageReport(comm, stats.stageCycles, stats.load.keysTested);
 
-    // Clean up
-    delete[] plaintextBuffer;
-    delete[] ciphertext;
+    HdrHistogram allChunkTimes = stats.chunkTimes.reduce(comm);
+    HdrHistogram allStopLatency = stats.stopLatency.reduce(comm);
+    if (processId == 0) {
+        std::cout << "Chunk time: " << allChunkTimes.summary("us") << std::endl;
+        std::cout << "Found-to-stopped latency: " << allStopLatency.summary("us") << std::endl;
+        if (turnaround.count() > 0) {
+            std::cout << "Job turnaround: " << turnaround.summary("us") << std::endl;
+        }
+    }
+
+    if (!options.traceFile.empty()) {
+        trace::writeChromeTrace(comm, options.traceFile);
+    }
 
-    MPI_Finalize();
     return 0;
 }
+
+/**
+ * @brief Main function: runs the driver with the cipher selected by --mode.
+ */
+int main(int argc, char* argv[]) {
+    // Initialize MPI environment
+    MPI_Init(&argc, &argv);
+
+    // runDriver reports invalid options itself
+    DriverOptions options;
+    std::string optionsError;
+    bool rc4 = parseDriverOptions(argc, argv, options, optionsError) && options.engine == ENGINE_RC4_40;
+    int status = rc4 ? runDriver<Rc4Cipher40>(MPI_COMM_WORLD, argc, argv)
+                     : runDriver<DesCipher>(MPI_COMM_WORLD, argc, argv);
+    MPI_Finalize();
+    return status;
+}
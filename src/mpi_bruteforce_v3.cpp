@@ -1,7 +1,6 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
-#include <openssl/des.h>
 #include <mpi.h>
 #include <chrono>
 #include <algorithm>
@@ -13,6 +12,12 @@
 #include <mutex>
 #include <condition_variable>
 
+#include "cipher_policy.h"
+#include "driver_options.h"
+#include "hdr_histogram.h"
+#include "job_descriptor.h"
+#include "trace.h"
+
 #define DEBUG 0
 
 /**
@@ -57,88 +62,6 @@ static inline void trim(std::string &s) {
 }
 
 
-/**
- * @brief Encrypts the plaintext using DES with the specified key.
- *
- * @param key The 8-byte DES key.
- * @param plaintext The input data to encrypt.
- * @param ciphertext The buffer to store encrypted data.
- * @param len Length of the plaintext.
- */
-void encrypt(const unsigned char* key, const unsigned char* plaintext, unsigned char* ciphertext, int len) {
-    DES_cblock keyBlock;
-    DES_key_schedule keySchedule;
-
-    memcpy(keyBlock, key, 8);
-
-    // Suppress deprecated warnings for OpenSSL DES functions
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-
-    // Set the key parity bits
-    DES_set_odd_parity(&keyBlock);
-
-    // Check if the key is weak or has incorrect parity
-    if (DES_set_key_checked(&keyBlock, &keySchedule) != 0) {
-        std::cerr << "Encryption key error in DES_set_key_checked" << std::endl;
-        exit(1);
-    }
-
-    for (int i = 0; i < len; i += 8) {
-        DES_ecb_encrypt((const_DES_cblock*)(plaintext + i), (DES_cblock*)(ciphertext + i), &keySchedule, DES_ENCRYPT);
-    }
-
-    #pragma GCC diagnostic pop  // Restore the previous warning settings
-}
-
-/**
- * @brief Decrypts the ciphertext using DES with the specified key.
- *
- * @param key The 8-byte DES key.
- * @param ciphertext The encrypted data.
- * @param plaintext The buffer to store decrypted data.
- * @param len Length of the ciphertext.
- */
-void decrypt(const unsigned char* key, const unsigned char* ciphertext, unsigned char* plaintext, int len) {
-    DES_cblock keyBlock;
-    DES_key_schedule keySchedule;
-
-    memcpy(keyBlock, key, 8);
-
-    // Suppress deprecated warnings for OpenSSL DES functions
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-
-    // Set the key parity bits
-    DES_set_odd_parity(&keyBlock);
-
-    // Check if the key is weak or has incorrect parity
-    if (DES_set_key_checked(&keyBlock, &keySchedule) != 0) {
-        #if DEBUG
-        std::cerr << "Decryption key error in DES_set_key_checked" << std::endl;
-        #endif
-        return;  // Skip decryption with this key
-    }
-
-    for (int i = 0; i < len; i += 8) {
-        DES_ecb_encrypt((const_DES_cblock*)(ciphertext + i), (DES_cblock*)(plaintext + i), &keySchedule, DES_DECRYPT);
-    }
-
-    #pragma GCC diagnostic pop  // Restore the previous warning settings
-}
-
-/**
- * @brief Converts a long integer to an 8-byte key.
- *
- * @param key The long integer key.
- * @param keyArray The buffer to store the converted 8-byte key.
- */
-void longToKey(long key, unsigned char* keyArray) {
-    for (int i = 0; i < 8; ++i) {
-        keyArray[7 - i] = (key >> (i * 8)) & 0xFF;
-    }
-}
-
 /**
  * @brief Attempts to decrypt the ciphertext with the given key and checks for the search phrase.
  *
@@ -149,12 +72,13 @@ void longToKey(long key, unsigned char* keyArray) {
  * @return true If the decrypted text contains the search phrase.
  * @return false Otherwise.
  */
+template <typename Cipher>
 bool tryKey(long key, const unsigned char* ciphertext, int len, const std::string& searchPhrase) {
     unsigned char temp[len + 1];
-    unsigned char keyArray[8];
+    unsigned char keyArray[Cipher::kKeyBytes];
 
-    longToKey(key, keyArray);
-    decrypt(keyArray, ciphertext, temp, len);
+    Cipher::keyFromInteger(key, keyArray);
+    Cipher::decrypt(keyArray, ciphertext, temp, len);
     temp[len] = '\0';  // Null-terminate the decrypted text
 
     // Check if decryption was successful before searching
@@ -172,6 +96,7 @@ public:
     long end;
     double priority;
 
+    KeySpace() : start(0), end(0), priority(0) {}
     KeySpace(long s, long e, double p) : start(s), end(e), priority(p) {}
 
     bool operator<(const KeySpace& other) const {
@@ -217,28 +142,38 @@ std::vector<KeySpace> generateIntelligentKeySpaces(long start, long end, int num
     return spaces;
 }
 
+// Trace lanes (trace.h): the main thread, then one per pipeline stage, whose threads are
+// started anew for every key space
+static const uint32_t kMainLane = 0;
+static const uint32_t kGenerateLane = 1;
+static const uint32_t kDecryptLane = 2;
+static const uint32_t kCompareLane = 3;
+
+template <typename Cipher>
 class ParallelKeySearch {
 private:
+    const JobDescriptor& job;
     const unsigned char* ciphertext;
     int len;
-    const std::string& searchPhrase;
 
 public:
-    ParallelKeySearch(const unsigned char* ct, int l, const std::string& phrase)
-        : ciphertext(ct), len(l), searchPhrase(phrase) {}
+    explicit ParallelKeySearch(const JobDescriptor& j)
+        : job(j), ciphertext(j.ciphertext.data()), len(j.ciphertext.size()) {}
 
     bool tryKey(long key) const {
-        unsigned char keyArray[8];
-        longToKey(key, keyArray);
+        unsigned char keyArray[Cipher::kKeyBytes];
+        Cipher::keyFromInteger(key, keyArray);
 
-        unsigned char decrypted[len + 1];
-        decrypt(keyArray, ciphertext, decrypted, len);
-        decrypted[len] = '\0';
+        unsigned char decrypted[len];
+        Cipher::decrypt(keyArray, ciphertext, decrypted, len);
+        job.unchain(decrypted);
 
-        return strstr(reinterpret_cast<char*>(decrypted), searchPhrase.c_str()) != nullptr;
+        return job.matches(decrypted);
     }
 
     void pipelineGenerate(KeySpace space, PipelineData& data) {
+        trace::setLane(kGenerateLane);
+        trace::Scope chunkScope(trace::CHUNK, space.start);
         for (long key = space.start; key < space.end; ++key) {
             {
                 std::unique_lock<std::mutex> lock(data.mtx);
@@ -249,7 +184,9 @@ public:
         }
     }
 
-    void pipelineEncrypt(PipelineData& data) {
+    void pipelineEncrypt(PipelineData& data, long first) {
+        trace::setLane(kDecryptLane);
+        trace::Scope chunkScope(trace::CHUNK, first);
         while (!data.keyFound) {
             long key;
             {
@@ -260,11 +197,12 @@ public:
                 data.generatedKeys.pop();
             }
 
-            unsigned char keyArray[8];
-            longToKey(key, keyArray);
+            unsigned char keyArray[Cipher::kKeyBytes];
+            Cipher::keyFromInteger(key, keyArray);
 
             std::vector<unsigned char> decrypted(len);
-            decrypt(keyArray, ciphertext, decrypted.data(), len);
+            Cipher::decrypt(keyArray, ciphertext, decrypted.data(), len);
+            job.unchain(decrypted.data());
 
             {
                 std::unique_lock<std::mutex> lock(data.mtx);
@@ -274,7 +212,9 @@ public:
         }
     }
 
-    void pipelineCompare(PipelineData& data) {
+    void pipelineCompare(PipelineData& data, long first) {
+        trace::setLane(kCompareLane);
+        trace::Scope chunkScope(trace::CHUNK, first);
         while (!data.keyFound) {
             std::pair<long, std::vector<unsigned char>> item;
             {
@@ -285,7 +225,7 @@ public:
                 data.encryptedData.pop();
             }
 
-            if (strstr(reinterpret_cast<char*>(item.second.data()), searchPhrase.c_str()) != nullptr) {
+            if (job.matches(item.second.data())) {
                 data.keyFound = true;
                 data.foundKey = item.first;
                 data.cv.notify_all();
@@ -298,8 +238,8 @@ public:
         PipelineData pipelineData;
 
         std::thread generateThread(&ParallelKeySearch::pipelineGenerate, this, space, std::ref(pipelineData));
-        std::thread encryptThread(&ParallelKeySearch::pipelineEncrypt, this, std::ref(pipelineData));
-        std::thread compareThread(&ParallelKeySearch::pipelineCompare, this, std::ref(pipelineData));
+        std::thread encryptThread(&ParallelKeySearch::pipelineEncrypt, this, std::ref(pipelineData), space.start);
+        std::thread compareThread(&ParallelKeySearch::pipelineCompare, this, std::ref(pipelineData), space.start);
 
         generateThread.join();
         encryptThread.join();
@@ -309,49 +249,89 @@ public:
     }
 };
 
-int main(int argc, char* argv[]) {
-    MPI_Init(&argc, &argv);
-
+/**
+ * @brief Runs the driver with the given cipher (cipher_policy.h).
+ *
+ * @return Process exit status.
+ */
+template <typename Cipher>
+static int runDriver(MPI_Comm comm, int argc, char* argv[]) {
     int numProcesses, processId;
-    MPI_Comm comm = MPI_COMM_WORLD;
 
     MPI_Comm_size(comm, &numProcesses);
     MPI_Comm_rank(comm, &processId);
 
     std::string plaintext;
     std::string searchPhrase;
-    long encryptionKey;
+    long encryptionKey = 0;
+
+    // Every process parses the command line so that all of them see the same options
+    DriverOptions options;
+    std::string optionsError;
+    bool optionsValid = parseDriverOptions(argc, argv, options, optionsError);
+    if (optionsValid && options.engine == ENGINE_RC4_40) {
+        optionsError = "--mode rc4-40 is supported by mpi_bruteforce_v2 only";
+        optionsValid = false;
+    }
+    if (optionsValid && !options.pairs.empty()) {
+        optionsError = "--pair is supported by mpi_bruteforce_v2 only";
+        optionsValid = false;
+    }
+    if (optionsValid && (!options.corpus.empty() || options.corpusMode != CORPUS_JOBS)) {
+        optionsError = "--corpus and --corpus-mode are supported by mpi_bruteforce_v2 only";
+        optionsValid = false;
+    }
+    if (optionsValid && (options.deadlineSeconds > 0 || !options.checkpointFile.empty() ||
+                         options.prior != PRIOR_UNIFORM)) {
+        optionsError = "--deadline, --checkpoint and --prior are supported by mpi_bruteforce_v2 only";
+        optionsValid = false;
+    }
+    if (optionsValid && (options.metricsPort != 0 || !options.metricsSocket.empty())) {
+        optionsError = "--metrics-port and --metrics-socket are supported by mpi_bruteforce_v2 only";
+        optionsValid = false;
+    }
+    if (optionsValid && !options.cacheDir.empty()) {
+        optionsError = "--cache is supported by mpi_bruteforce_v2 only";
+        optionsValid = false;
+    }
+    if (optionsValid && !options.traceFile.empty()) {
+        trace::enable();
+        trace::setLane(kMainLane);
+    }
 
     // Process 0 reads the input files and broadcasts the data
     if (processId == 0) {
-        if (argc != 4) {
-            std::cerr << "Usage: " << argv[0] << " <input_file> <encryption_key> <search_phrase_file>" << std::endl;
-            MPI_Abort(comm, 1);
-        }
-
-        // Load plaintext from the file, skipping empty lines
-        std::ifstream inputFile(argv[1]);
-        if (!inputFile) {
-            std::cerr << "Failed to open input file." << std::endl;
+        if (!optionsValid) {
+            std::cerr << optionsError << std::endl;
+            printUsage(argv[0]);
             MPI_Abort(comm, 1);
         }
 
-        std::string line;
+        // Load plaintext from the file, skipping empty lines (ciphertext formats are loaded below)
         bool firstLine = true; // Flag to handle spacing correctly
-        while (std::getline(inputFile, line)) {
-            trim(line);
-            if (!line.empty()) {
-                if (!firstLine) {
-                    plaintext += ' ';  // Add a space between lines
+        if (options.inputFormat == FORMAT_PLAIN) {
+            std::ifstream inputFile(options.inputFile);
+            if (!inputFile) {
+                std::cerr << "Failed to open input file." << std::endl;
+                MPI_Abort(comm, 1);
+            }
+
+            std::string line;
+            while (std::getline(inputFile, line)) {
+                trim(line);
+                if (!line.empty()) {
+                    if (!firstLine) {
+                        plaintext += ' ';  // Add a space between lines
+                    }
+                    plaintext += line;
+                    firstLine = false;
                 }
-                plaintext += line;
-                firstLine = false;
             }
+            inputFile.close();
         }
-        inputFile.close();
 
         // Load the search phrase from the file, skipping empty lines
-        std::ifstream searchPhraseFile(argv[3]);
+        std::ifstream searchPhraseFile(options.searchPhraseFile);
         if (!searchPhraseFile) {
             std::cerr << "Failed to open search phrase file." << std::endl;
             MPI_Abort(comm, 1);
@@ -372,57 +352,53 @@ int main(int argc, char* argv[]) {
         searchPhraseFile.close();
 
         // Convert encryption key to long
-        encryptionKey = std::stol(argv[2]);
-
-        std::cout << "Plaintext: " << plaintext << std::endl;
+        if (options.inputFormat == FORMAT_PLAIN) {
+            encryptionKey = std::stol(options.encryptionKey);
+            std::cout << "Plaintext: " << plaintext << std::endl;
+        }
         std::cout << "Search phrase: " << searchPhrase << std::endl;
     }
 
-    // Broadcast encryption key length and value
-    MPI_Bcast(&encryptionKey, 1, MPI_LONG, 0, comm);
-
-    // Broadcast plaintext length and content
-    int plaintextLength;
-    if (processId == 0) {
-        plaintextLength = plaintext.size();
-    }
-    MPI_Bcast(&plaintextLength, 1, MPI_INT, 0, comm);
-
-    if (processId != 0) {
-        plaintext.resize(plaintextLength);
-    }
-    MPI_Bcast(&plaintext[0], plaintextLength, MPI_CHAR, 0, comm);
-
-    // Broadcast search phrase length and content
-    int searchPhraseLength;
-    if (processId == 0) {
-        searchPhraseLength = searchPhrase.size();
-    }
-    MPI_Bcast(&searchPhraseLength, 1, MPI_INT, 0, comm);
-
-    if (processId != 0) {
-        searchPhrase.resize(searchPhraseLength);
+    // Process 0 encrypts the plaintext (or loads the ciphertext) and keeps the full ciphertext for
+    // verification; the other processes only receive the ciphertext blocks the predicate needs
+    JobDescriptor job;
+    std::vector<unsigned char> ciphertext;
+    unsigned char keyArray[Cipher::kKeyBytes];
+    if (processId == 0 && options.inputFormat == FORMAT_PLAIN) {
+        // Pad plaintext to multiple of 8 bytes
+        int paddedLength = ((plaintext.size() + 7) / 8) * 8;
+        std::vector<unsigned char> plaintextBuffer(paddedLength, 0);
+        std::copy(plaintext.begin(), plaintext.end(), plaintextBuffer.begin());
+
+        // Encrypt the plaintext
+        ciphertext.resize(paddedLength);
+        Cipher::keyFromInteger(encryptionKey, keyArray);
+        Cipher::encrypt(keyArray, plaintextBuffer.data(), ciphertext.data(), paddedLength, options.cbcIv());
+        job = makeJob(ciphertext.data(), paddedLength, plaintext, searchPhrase, options.cbcIv());
+
+        if (!options.dumpCiphertext.empty() && !writeCiphertext(options.dumpCiphertext, ciphertext.data(), paddedLength)) {
+            std::cerr << "Failed to write ciphertext to " << options.dumpCiphertext << std::endl;
+            MPI_Abort(comm, 1);
+        }
+    } else if (processId == 0) {
+        std::string loadError;
+        if (!loadCiphertextJob(options.inputFile, options.inputFormat, searchPhrase, options.cribOffset, job,
+                               ciphertext, loadError, options.cbcIv())) {
+            std::cerr << loadError << std::endl;
+            MPI_Abort(comm, 1);
+        }
+        std::cout << "Ciphertext: " << job.cipherLength << " bytes, searching " << job.ciphertext.size()
+                  << " bytes at offset " << job.windowOffset << std::endl;
     }
-    MPI_Bcast(&searchPhrase[0], searchPhraseLength, MPI_CHAR, 0, comm);
-
-    // Pad plaintext to multiple of 8 bytes
-    int paddedLength = ((plaintext.size() + 7) / 8) * 8;
-    std::vector<unsigned char> plaintextBuffer(paddedLength, 0);
-    std::copy(plaintext.begin(), plaintext.end(), plaintextBuffer.begin());
-
-    // Encrypt the plaintext
-    std::vector<unsigned char> ciphertext(paddedLength);
-    unsigned char keyArray[8];
-    longToKey(encryptionKey, keyArray);
-    encrypt(keyArray, plaintextBuffer.data(), ciphertext.data(), paddedLength);
+    broadcastJob(comm, job);
 
     // Set up parallel key search
-    ParallelKeySearch keySearch(ciphertext.data(), paddedLength, searchPhrase);
+    ParallelKeySearch<Cipher> keySearch(job);
 
     // Generate intelligent key spaces
     std::vector<KeySpace> keySpaces;
     if (processId == 0) {
-        keySpaces = generateIntelligentKeySpaces(0, (1L << 56) - 1, numProcesses * 10);  // 10 spaces per process
+        keySpaces = generateIntelligentKeySpaces(0, job.keyspace - 1, numProcesses * 10);  // 10 spaces per process
     }
 
     // Distribute initial key spaces
@@ -444,11 +420,13 @@ int main(int argc, char* argv[]) {
     for (int i = 0; i < localSpacesCount; ++i) {
         KeySpace space;
         MPI_Recv(&space, sizeof(KeySpace), MPI_BYTE, 0, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        trace::instant(trace::LEASE, space.start);
         localKeySpaces.push_back(space);
     }
 
     long foundKey = 0;
     bool keyFound = false;
+    HdrHistogram leaseRtt;  // Round trip of work requests to process 0 (us)
 
     auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -457,7 +435,10 @@ int main(int argc, char* argv[]) {
         KeySpace space = localKeySpaces.back();
         localKeySpaces.pop_back();
 
-        foundKey = keySearch.searchRange(space);
+        {
+            trace::Scope chunkScope(trace::CHUNK, space.start);
+            foundKey = keySearch.searchRange(space);
+        }
 
         if (foundKey != 0) {
             keyFound = true;
@@ -469,7 +450,10 @@ int main(int argc, char* argv[]) {
 
         // Check if other processes found the key
         int flag;
-        MPI_Iprobe(MPI_ANY_SOURCE, 2, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+        {
+            trace::Scope pollScope(trace::POLL);
+            MPI_Iprobe(MPI_ANY_SOURCE, 2, MPI_COMM_WORLD, &flag, MPI_STATUS_IGNORE);
+        }
         if (flag) {
             MPI_Recv(&foundKey, 1, MPI_LONG, MPI_ANY_SOURCE, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
             keyFound = true;
@@ -478,8 +462,15 @@ int main(int argc, char* argv[]) {
 
         // Request more work if local queue is empty
         if (localKeySpaces.empty() && processId != 0) {
-            MPI_Send(&processId, 1, MPI_INT, 0, 3, MPI_COMM_WORLD);
-            MPI_Recv(&space, sizeof(KeySpace), MPI_BYTE, 0, 4, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            {
+                trace::Scope idleScope(trace::IDLE);
+                auto requestStart = std::chrono::high_resolution_clock::now();
+                MPI_Send(&processId, 1, MPI_INT, 0, 3, MPI_COMM_WORLD);
+                MPI_Recv(&space, sizeof(KeySpace), MPI_BYTE, 0, 4, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                leaseRtt.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::high_resolution_clock::now() - requestStart).count());
+            }
+            trace::instant(trace::LEASE, space.start);
             if (space.start != space.end) {  // Valid space
                 localKeySpaces.push_back(space);
             }
@@ -489,7 +480,10 @@ int main(int argc, char* argv[]) {
         if (processId == 0) {
             int requestingRank;
             MPI_Status status;
-            MPI_Recv(&requestingRank, 1, MPI_INT, MPI_ANY_SOURCE, 3, MPI_COMM_WORLD, &status);
+            {
+                trace::Scope idleScope(trace::IDLE);
+                MPI_Recv(&requestingRank, 1, MPI_INT, MPI_ANY_SOURCE, 3, MPI_COMM_WORLD, &status);
+            }
             if (!keySpaces.empty()) {
                 KeySpace spaceToSend = keySpaces.back();
                 keySpaces.pop_back();
@@ -509,9 +503,10 @@ int main(int argc, char* argv[]) {
             std::cout << "Key found: " << foundKey << std::endl;
 
             // Verify the found key
-            std::vector<unsigned char> decrypted(paddedLength);
-            longToKey(foundKey, keyArray);
-            decrypt(keyArray, ciphertext.data(), decrypted.data(), paddedLength);
+            trace::Scope verifyScope(trace::VERIFY, foundKey);
+            std::vector<unsigned char> decrypted(ciphertext.size());
+            Cipher::keyFromInteger(foundKey, keyArray);
+            Cipher::decrypt(keyArray, ciphertext.data(), decrypted.data(), ciphertext.size(), job.ivFor(ciphertext.size()));
             decrypted.push_back('\0');
 
             std::cout << "Decrypted text: -" << reinterpret_cast<char*>(decrypted.data()) << "-" << std::endl;
@@ -521,6 +516,21 @@ int main(int argc, char* argv[]) {
         std::cout << "Execution time: " << duration.count() << " seconds" << std::endl;
     }
 
-    MPI_Finalize();
+    HdrHistogram allLeaseRtt = leaseRtt.reduce(comm);
+    if (processId == 0) {
+        std::cout << "Lease round trip: " << allLeaseRtt.summary("us") << std::endl;
+    }
+
+    if (!options.traceFile.empty()) {
+        trace::writeChromeTrace(comm, options.traceFile);
+    }
+
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    MPI_Init(&argc, &argv);
+    int status = runDriver<DesCipher>(MPI_COMM_WORLD, argc, argv);
+    MPI_Finalize();
+    return status;
+}
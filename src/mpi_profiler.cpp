@@ -0,0 +1,348 @@
+/**
+ * @file mpi_profiler.cpp
+ * @brief PMPI interposition library that counts and times the MPI calls of the drivers.
+ *
+ * Every wrapped call is forwarded to its `PMPI_` counterpart and accounted per rank and
+ * per call site (the return address of the caller). At `MPI_Finalize` process 0 prints a
+ * per-call summary over all ranks followed by the per-rank, per-site breakdown. The
+ * call site is reported as `module+offset`, which `addr2line -e <module>` resolves.
+ *
+ * The wrapped calls are the point-to-point and collective calls the drivers and tools make
+ * (see CallId); others (e.g. MPI_Comm_dup, MPI_Get_count) are not timed.
+ *
+ * @note Build as a shared library and preload it; the drivers need no changes:
+ * mpic++ -shared -fPIC -o libmpiprof.so mpi_profiler.cpp -ldl
+ *
+ * Example usage:
+ * mpirun -np 4 -x LD_PRELOAD=./libmpiprof.so ./mpi_bruteforce_v2 plaintext.txt 123456 search_phrase.txt
+ *
+ * Set MPIPROF_FILE to write the summary to a file instead of standard error.
+ *
+ * @date October 2024
+ */
+
+#include <mpi.h>
+#include <dlfcn.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief MPI calls accounted by the profiler.
+ */
+enum CallId {
+    CALL_BCAST,
+    CALL_SEND,
+    CALL_RECV,
+    CALL_IRECV,
+    CALL_IPROBE,
+    CALL_TEST,
+    CALL_BARRIER,
+    CALL_ISEND,
+    CALL_WAIT,
+    CALL_PROBE,
+    CALL_GATHER,
+    CALL_GATHERV,
+    CALL_SCATTER,
+    CALL_REDUCE,
+    CALL_ALLREDUCE,
+    CALL_ALLGATHER,
+    CALL_ALLGATHERV,
+    CALL_ALLTOALL,
+    CALL_ALLTOALLV,
+    NUM_CALLS
+};
+
+const char* const kCallNames[NUM_CALLS] = {
+    "MPI_Bcast", "MPI_Send", "MPI_Recv", "MPI_Irecv", "MPI_Iprobe", "MPI_Test", "MPI_Barrier",
+    "MPI_Isend", "MPI_Wait", "MPI_Probe", "MPI_Gather", "MPI_Gatherv", "MPI_Scatter", "MPI_Reduce",
+    "MPI_Allreduce", "MPI_Allgather", "MPI_Allgatherv", "MPI_Alltoall", "MPI_Alltoallv"
+};
+
+/**
+ * @brief Accumulated statistics of one call at one call site.
+ */
+struct CallStats {
+    uint64_t count = 0;    ///< Number of calls.
+    uint64_t hits = 0;     ///< Calls that completed or matched (Iprobe/Test flag set).
+    uint64_t totalNs = 0;  ///< Total time spent inside the call.
+    uint64_t maxNs = 0;    ///< Longest single call.
+};
+
+std::mutex statsMutex;
+std::map<std::pair<int, void*>, CallStats> stats;
+
+inline uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Adds one call to the statistics of its call site.
+ */
+void account(CallId call, void* site, uint64_t startNs, bool hit) {
+    uint64_t elapsed = nowNs() - startNs;
+    std::lock_guard<std::mutex> lock(statsMutex);
+    CallStats& s = stats[std::make_pair(static_cast<int>(call), site)];
+    ++s.count;
+    s.hits += hit ? 1 : 0;
+    s.totalNs += elapsed;
+    s.maxNs = std::max(s.maxNs, elapsed);
+}
+
+/**
+ * @brief Formats a return address as `module+0xoffset`.
+ */
+std::string describeSite(void* site) {
+    Dl_info info;
+    char buffer[512];
+    if (dladdr(site, &info) && info.dli_fname) {
+        const char* module = info.dli_fname;
+        const char* slash = strrchr(module, '/');
+        snprintf(buffer, sizeof(buffer), "%s+0x%lx", slash ? slash + 1 : module,
+                 static_cast<unsigned long>(reinterpret_cast<uintptr_t>(site) -
+                                            reinterpret_cast<uintptr_t>(info.dli_fbase)));
+    } else {
+        snprintf(buffer, sizeof(buffer), "%p", site);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Gathers the per-rank reports on process 0 and writes the summary.
+ */
+void writeSummary() {
+    int numProcesses, processId;
+    PMPI_Comm_size(MPI_COMM_WORLD, &numProcesses);
+    PMPI_Comm_rank(MPI_COMM_WORLD, &processId);
+
+    // Per-call totals of this rank: count, time, max
+    double totals[NUM_CALLS][3] = {};
+    std::ostringstream local;
+    for (const auto& entry : stats) {
+        const CallStats& s = entry.second;
+        int call = entry.first.first;
+        totals[call][0] += s.count;
+        totals[call][1] += s.totalNs / 1e9;
+        totals[call][2] = std::max(totals[call][2], s.maxNs / 1e9);
+
+        char line[768];
+        snprintf(line, sizeof(line), "%6d  %-14s %12llu %12llu %14.6f %12.3f  %s\n", processId,
+                 kCallNames[call], static_cast<unsigned long long>(s.count),
+                 static_cast<unsigned long long>(s.hits), s.totalNs / 1e9,
+                 s.count ? s.totalNs / 1e3 / s.count : 0.0, describeSite(entry.first.second).c_str());
+        local << line;
+    }
+
+    double sums[NUM_CALLS][3], maxima[NUM_CALLS][3];
+    PMPI_Reduce(totals, sums, NUM_CALLS * 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    PMPI_Reduce(totals, maxima, NUM_CALLS * 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    std::string text = local.str();
+    int length = text.size();
+    std::vector<int> lengths(numProcesses), displs(numProcesses);
+    PMPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    int total = 0;
+    for (int r = 0; r < numProcesses; ++r) {
+        displs[r] = total;
+        total += lengths[r];
+    }
+    std::vector<char> all(processId == 0 ? total + 1 : 1);
+    PMPI_Gatherv(&text[0], length, MPI_CHAR, all.data(), lengths.data(), displs.data(), MPI_CHAR, 0,
+                 MPI_COMM_WORLD);
+
+    if (processId != 0) {
+        return;
+    }
+
+    const char* path = getenv("MPIPROF_FILE");
+    FILE* out = path ? fopen(path, "w") : stderr;
+    if (!out) {
+        fprintf(stderr, "mpiprof: failed to open %s\n", path);
+        out = stderr;
+    }
+
+    fprintf(out, "==== MPI profile (%d ranks) ====\n", numProcesses);
+    fprintf(out, "%-14s %12s %14s %14s %14s\n", "Call", "Calls", "Total [s]", "Max rank [s]", "Longest [s]");
+    for (int call = 0; call < NUM_CALLS; ++call) {
+        if (sums[call][0] == 0) {
+            continue;
+        }
+        fprintf(out, "%-14s %12.0f %14.6f %14.6f %14.6f\n", kCallNames[call], sums[call][0], sums[call][1],
+                maxima[call][1], maxima[call][2]);
+    }
+    fprintf(out, "\n%6s  %-14s %12s %12s %14s %12s  %s\n", "Rank", "Call", "Calls", "Hits", "Total [s]",
+            "Mean [us]", "Call site");
+    all[total] = '\0';
+    fputs(all.data(), out);
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+
+}  // namespace
+
+extern "C" {
+
+int MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Bcast(buffer, count, datatype, root, comm);
+    account(CALL_BCAST, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Send(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Send(buf, count, datatype, dest, tag, comm);
+    account(CALL_SEND, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+             MPI_Status* status) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
+    account(CALL_RECV, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+              MPI_Request* request) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+    account(CALL_IRECV, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int* flag, MPI_Status* status) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Iprobe(source, tag, comm, flag, status);
+    account(CALL_IPROBE, __builtin_return_address(0), start, *flag != 0);
+    return rc;
+}
+
+int MPI_Test(MPI_Request* request, int* flag, MPI_Status* status) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Test(request, flag, status);
+    account(CALL_TEST, __builtin_return_address(0), start, *flag != 0);
+    return rc;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Barrier(comm);
+    account(CALL_BARRIER, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+              MPI_Request* request) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+    account(CALL_ISEND, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Wait(MPI_Request* request, MPI_Status* status) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Wait(request, status);
+    account(CALL_WAIT, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status* status) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Probe(source, tag, comm, status);
+    account(CALL_PROBE, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Gather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    account(CALL_GATHER, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Gatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, const int recvcounts[],
+                const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    account(CALL_GATHERV, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Scatter(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+                MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    account(CALL_SCATTER, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root,
+               MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+    account(CALL_REDUCE, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                  MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+    account(CALL_ALLREDUCE, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Allgather(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+                  MPI_Datatype recvtype, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    account(CALL_ALLGATHER, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Allgatherv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf,
+                   const int recvcounts[], const int displs[], MPI_Datatype recvtype, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+    account(CALL_ALLGATHERV, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Alltoall(const void* sendbuf, int sendcount, MPI_Datatype sendtype, void* recvbuf, int recvcount,
+                 MPI_Datatype recvtype, MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+    account(CALL_ALLTOALL, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Alltoallv(const void* sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype,
+                  void* recvbuf, const int recvcounts[], const int rdispls[], MPI_Datatype recvtype,
+                  MPI_Comm comm) {
+    uint64_t start = nowNs();
+    int rc = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    account(CALL_ALLTOALLV, __builtin_return_address(0), start, true);
+    return rc;
+}
+
+int MPI_Finalize(void) {
+    writeSummary();
+    return PMPI_Finalize();
+}
+
+}  // extern "C"
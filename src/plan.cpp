@@ -0,0 +1,495 @@
+/**
+ * @file plan.cpp
+ * @brief Capacity planner: predicts time-to-key and picks the cheapest rank x thread layout.
+ *
+ * The planner works from per-machine calibration rows (keys/s of one thread for a given
+ * engine, and whether the engine runs under MPI and with several threads), stored in a CSV
+ * file. Rows are produced either by measuring this machine or by
+ * importing the result CSV of the benchmark suite (scripts/all_tests.sh):
+ *
+ *     ./plan calibrate --machine lg
+ *     ./plan calibrate --machine cluster --from-benchmark data/times_cluster.csv
+ *
+ * Planning enumerates the rank x thread layouts each calibrated engine can run (one process
+ * for naive_sequential, one thread per rank for all drivers but v2) that fit the described
+ * cluster and predicts the expected and worst-case time to find a key placed
+ * uniformly in the key space, then recommends the layout using the fewest cores (and
+ * nodes) whose worst-case time meets the deadline:
+ *
+ *     ./plan --machine cluster --bits 40 --nodes 2 --cores-per-node 8 --deadline 3600
+ *
+ * @note Compile with OpenSSL:
+ * g++ -O2 -o plan plan.cpp -lcrypto
+ *
+ * @date October 2024
+ */
+
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <openssl/des.h>
+
+/**
+ * @brief One calibration row: the per-thread key rate of an engine on a machine.
+ */
+struct Calibration {
+    std::string machine;    ///< Machine name.
+    std::string engine;     ///< Engine or program name.
+    int blocks;             ///< Ciphertext blocks decrypted per key during calibration.
+    double keysPerSecond;   ///< Keys per second of a single thread.
+    double scheduleBlocks;  ///< Cost of the per-key work other than the rounds (mostly the key schedule), in blocks.
+    bool mpi;               ///< The engine runs as several MPI ranks.
+    bool threaded;          ///< The engine takes --threads.
+};
+
+/// Default for scheduleBlocks: the key schedule is about a third of the per-key cost of a
+/// 4-block window in the hot-path cycle counters (STAGE_CYCLES), i.e. about two blocks.
+static const double kScheduleBlocks = 2.0;
+
+/**
+ * @brief Sets what a program can run as: naive_sequential is a single process and only
+ * mpi_bruteforce_v2 (and the "des" hot loop measured by `calibrate`, which is v2's) uses
+ * several threads per rank.
+ */
+static void setCapabilities(Calibration& c) {
+    c.mpi = c.engine.find("naive_sequential") == std::string::npos;
+    c.threaded = c.engine == "des" || c.engine.find("v2") != std::string::npos;
+}
+
+/**
+ * @brief Scales a calibrated key rate to another window: a key costs the schedule plus one
+ * round function pass per block, both measured in blocks.
+ */
+static double scaleRate(const Calibration& c, int blocks) {
+    return c.keysPerSecond * (c.scheduleBlocks + c.blocks) / (c.scheduleBlocks + blocks);
+}
+
+/**
+ * @brief A candidate layout and its predicted times.
+ */
+struct Layout {
+    std::string engine;
+    bool mpi;       ///< Run with mpirun.
+    bool threaded;  ///< Pass --threads.
+    bool full;      ///< The most ranks the engine can use at this thread count.
+    int ranks;
+    int threads;
+    int nodes;
+    double keysPerSecond;
+    double expectedSeconds;
+    double worstSeconds;
+};
+
+/**
+ * @brief Splits a CSV line, honouring double-quoted fields.
+ */
+static std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (c == ',' && !quoted) {
+            fields.push_back(field);
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+/**
+ * @brief Loads the calibration rows of a machine (all machines when `machine` is empty).
+ *
+ * Rows without the Schedule_Blocks, MPI and Threaded columns (older files) get the
+ * defaults of their program.
+ *
+ * @param error Set to the offending line when a row does not parse.
+ * @return false If a row does not parse.
+ */
+static bool loadCalibration(const std::string& path, const std::string& machine, std::vector<Calibration>& rows,
+                            std::string& error) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);  // Header
+    while (std::getline(in, line)) {
+        std::vector<std::string> f = splitCsv(line);
+        if (f.size() < 4 || (!machine.empty() && f[0] != machine)) {
+            continue;
+        }
+        Calibration c;
+        c.machine = f[0];
+        c.engine = f[1];
+        setCapabilities(c);
+        c.scheduleBlocks = kScheduleBlocks;
+        try {
+            c.blocks = std::stoi(f[2]);
+            c.keysPerSecond = std::stod(f[3]);
+            if (f.size() >= 7) {
+                c.scheduleBlocks = std::stod(f[4]);
+                c.mpi = f[5] == "yes";
+                c.threaded = f[6] == "yes";
+            }
+        } catch (const std::exception&) {
+            error = "Invalid calibration row: " + line;
+            return false;
+        }
+        if (c.blocks < 1 || c.keysPerSecond <= 0 || c.scheduleBlocks < 0) {
+            error = "Invalid calibration row: " + line;
+            return false;
+        }
+        rows.push_back(c);
+    }
+    return true;
+}
+
+/**
+ * @brief Appends calibration rows, writing the header when the file is new.
+ */
+static bool appendCalibration(const std::string& path, const std::vector<Calibration>& rows) {
+    bool exists = std::ifstream(path).good();
+    std::ofstream out(path, std::ios::app);
+    if (!out) {
+        return false;
+    }
+    if (!exists) {
+        out << "Machine,Engine,Blocks,Keys_Per_Second_Per_Thread,Schedule_Blocks,MPI,Threaded\n";
+    }
+    for (const Calibration& c : rows) {
+        out << c.machine << "," << c.engine << "," << c.blocks << "," << c.keysPerSecond << "," << c.scheduleBlocks
+            << "," << (c.mpi ? "yes" : "no") << "," << (c.threaded ? "yes" : "no") << "\n";
+    }
+    return true;
+}
+
+/**
+ * @brief Measures the single-thread key rate of the OpenSSL DES hot loop used by the drivers.
+ *
+ * @param blocks Ciphertext blocks decrypted per key.
+ * @param seconds Measurement time.
+ */
+static double measureDesRate(int blocks, double seconds) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    std::vector<unsigned char> ciphertext(blocks * 8, 0x5a), plaintext(blocks * 8 + 1);
+    DES_cblock keyBlock;
+    DES_key_schedule keySchedule;
+    uint64_t keys = 0;
+    volatile unsigned long matches = 0;  // Keeps the predicate from being optimized away
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        for (int n = 0; n < 10000; ++n, ++keys) {
+            for (int i = 0; i < 8; ++i) {
+                keyBlock[7 - i] = (keys >> (i * 8)) & 0xFF;
+            }
+            DES_set_odd_parity(&keyBlock);
+            DES_set_key_unchecked(&keyBlock, &keySchedule);
+            for (int b = 0; b < blocks; ++b) {
+                DES_ecb_encrypt((const_DES_cblock*)(&ciphertext[b * 8]), (DES_cblock*)(&plaintext[b * 8]),
+                                &keySchedule, DES_DECRYPT);
+            }
+            plaintext[blocks * 8] = '\0';
+            matches = matches + (strstr(reinterpret_cast<char*>(plaintext.data()), "es una prueba de") != nullptr);
+        }
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+#pragma GCC diagnostic pop
+    return keys / elapsed;
+}
+
+/**
+ * @brief Measures how many block decryptions the rest of the per-key work costs, from the
+ * key rates at 1 and at 1 + `blocks` blocks.
+ */
+static double measureScheduleBlocks(int blocks, double seconds) {
+    double one = 1.0 / measureDesRate(1, seconds / 2);
+    double more = 1.0 / measureDesRate(1 + blocks, seconds / 2);
+    double perBlock = (more - one) / blocks;
+    return perBlock > 0 ? std::max(0.0, one / perBlock - 1) : kScheduleBlocks;
+}
+
+/**
+ * @brief Derives per-thread rates from the benchmark suite's result CSV.
+ *
+ * Keys are found by process 0, which scans its range from the bottom, so the found key
+ * divided by the execution time is the key rate of one rank (of 4 threads for v2, which
+ * the suite runs with the default --threads).
+ *
+ * @param error Set to the offending line when a row does not parse.
+ * @return false If a row does not parse.
+ */
+static bool importBenchmark(const std::string& path, const std::string& machine, int blocks,
+                            std::vector<Calibration>& rows, std::string& error) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);  // Header
+    while (std::getline(in, line)) {
+        std::vector<std::string> f = splitCsv(line);
+        if (f.size() < 7 || f[4].empty() || f[6].empty()) {
+            continue;
+        }
+        double keyFound, seconds;
+        try {
+            keyFound = std::stod(f[4]);
+            seconds = std::stod(f[6]);
+        } catch (const std::exception&) {
+            error = "Invalid benchmark row: " + line;
+            return false;
+        }
+        if (seconds < 1.0) {
+            continue;  // Startup dominates very short runs
+        }
+        Calibration program;
+        program.engine = f[0];
+        setCapabilities(program);
+        double rate = keyFound / seconds / (program.threaded ? 4 : 1);
+
+        // Keep the best sustained rate of each program
+        bool merged = false;
+        for (Calibration& c : rows) {
+            if (c.engine == f[0]) {
+                c.keysPerSecond = std::max(c.keysPerSecond, rate);
+                merged = true;
+            }
+        }
+        if (!merged) {
+            program.machine = machine;
+            program.blocks = blocks;
+            program.keysPerSecond = rate;
+            program.scheduleBlocks = kScheduleBlocks;
+            rows.push_back(program);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Formats a duration in seconds as a human-readable string.
+ */
+static std::string formatDuration(double seconds) {
+    std::ostringstream out;
+    out.precision(3);
+    if (seconds < 120) {
+        out << seconds << " s";
+    } else if (seconds < 7200) {
+        out << seconds / 60 << " min";
+    } else if (seconds < 172800) {
+        out << seconds / 3600 << " h";
+    } else if (seconds < 3.15e8) {
+        out << seconds / 86400 << " days";
+    } else {
+        out << seconds / 3.15e7 << " years";
+    }
+    return out.str();
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  " << program << " calibrate --machine <name> [--from-benchmark <times.csv>] [--blocks <n>]\n"
+              << "      [--seconds <s>] [--calibration <file>]\n"
+              << "  " << program << " --machine <name> (--bits <b> | --keyspace <n>) --nodes <n> --cores-per-node <c>\n"
+              << "      [--deadline <seconds>] [--blocks <n>] [--engine <name>] [--calibration <file>]\n"
+              << "Defaults: --calibration data/calibration.csv --blocks 4 --bits 56" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    bool calibrate = argc > 1 && std::string(argv[1]) == "calibrate";
+    std::string machine, benchmark, engineFilter;
+    std::string calibrationFile = "data/calibration.csv";
+    double keyspace = std::ldexp(1.0, 56);
+    double deadline = 0;
+    double seconds = 2.0;
+    int blocks = 4;
+    int nodes = 1, coresPerNode = 1;
+
+    bool valid = true;
+    for (int i = calibrate ? 2 : 1; i < argc && valid; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            valid = false;
+            break;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--machine") {
+                machine = value;
+            } else if (arg == "--from-benchmark") {
+                benchmark = value;
+            } else if (arg == "--calibration") {
+                calibrationFile = value;
+            } else if (arg == "--bits") {
+                keyspace = std::ldexp(1.0, std::stoi(value));
+            } else if (arg == "--keyspace") {
+                keyspace = std::stod(value);
+            } else if (arg == "--nodes") {
+                nodes = std::stoi(value);
+            } else if (arg == "--cores-per-node") {
+                coresPerNode = std::stoi(value);
+            } else if (arg == "--deadline") {
+                deadline = std::stod(value);
+            } else if (arg == "--blocks") {
+                blocks = std::stoi(value);
+            } else if (arg == "--seconds") {
+                seconds = std::stod(value);
+            } else if (arg == "--engine") {
+                engineFilter = value;
+            } else {
+                valid = false;
+            }
+        } catch (const std::exception&) {
+            valid = false;  // std::stoi / std::stod rejected the value
+        }
+    }
+    if (!valid || machine.empty() || nodes < 1 || coresPerNode < 1 || blocks < 1 || keyspace <= 0 ||
+        seconds <= 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (calibrate) {
+        std::vector<Calibration> rows;
+        std::string error;
+        if (!benchmark.empty()) {
+            if (!importBenchmark(benchmark, machine, blocks, rows, error)) {
+                std::cerr << error << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            Calibration c;
+            c.machine = machine;
+            c.engine = "des";
+            setCapabilities(c);
+            c.blocks = blocks;
+            c.keysPerSecond = measureDesRate(blocks, seconds);
+            c.scheduleBlocks = measureScheduleBlocks(blocks, seconds);
+            rows.push_back(c);
+        }
+        if (rows.empty() || !appendCalibration(calibrationFile, rows)) {
+            std::cerr << "No calibration written." << std::endl;
+            return 1;
+        }
+        for (const Calibration& c : rows) {
+            std::cout << c.machine << " " << c.engine << ": " << c.keysPerSecond << " keys/s per thread, schedule ~"
+                      << c.scheduleBlocks << " blocks" << std::endl;
+        }
+        return 0;
+    }
+
+    std::vector<Calibration> rows;
+    std::string error;
+    if (!loadCalibration(calibrationFile, machine, rows, error)) {
+        std::cerr << error << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (rows.empty()) {
+        std::cerr << "No calibration for machine " << machine << " in " << calibrationFile
+                  << "; run '" << argv[0] << " calibrate' first." << std::endl;
+        return 1;
+    }
+
+    // Enumerate the layouts each engine can run: ranks x threads with any thread count per rank
+    // that fits on a node, one thread per rank without --threads, one process without MPI
+    std::vector<Layout> layouts;
+    for (const Calibration& c : rows) {
+        if (!engineFilter.empty() && c.engine != engineFilter) {
+            continue;
+        }
+        // A key costs its schedule plus the rounds of every block, so a smaller window gains less than 1/blocks
+        double threadRate = scaleRate(c, blocks);
+        int maxThreads = c.threaded ? coresPerNode : 1;
+        for (int threads = 1; threads <= maxThreads; ++threads) {
+            int ranksPerNode = coresPerNode / threads;
+            int maxRanks = c.mpi ? nodes * ranksPerNode : 1;
+            for (int ranks = 1; ranks <= maxRanks; ++ranks) {
+                Layout l;
+                l.engine = c.engine;
+                l.mpi = c.mpi;
+                l.threaded = c.threaded;
+                l.full = ranks == maxRanks;
+                l.ranks = ranks;
+                l.threads = threads;
+                l.nodes = (ranks + ranksPerNode - 1) / ranksPerNode;
+                l.keysPerSecond = threadRate * ranks * threads;
+                // Static split: every rank scans keyspace/ranks keys from the bottom of its range
+                l.worstSeconds = keyspace / l.keysPerSecond;
+                l.expectedSeconds = l.worstSeconds / 2;
+                layouts.push_back(l);
+            }
+        }
+    }
+    if (layouts.empty()) {
+        std::cerr << "No calibrated engine matches." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Key space: " << keyspace << " keys, cluster: " << nodes << " x " << coresPerNode
+              << " cores, machine: " << machine << std::endl;
+    std::printf("%-26s %6s %8s %6s %14s %14s %14s\n", "Engine", "Ranks", "Threads", "Nodes", "Keys/s",
+                "Expected", "Worst case");
+
+    // Show the largest layout of each engine and thread count
+    for (const Layout& l : layouts) {
+        if (l.full) {
+            std::printf("%-26s %6d %8d %6d %14.4g %14s %14s\n", l.engine.c_str(), l.ranks, l.threads, l.nodes,
+                        l.keysPerSecond, formatDuration(l.expectedSeconds).c_str(),
+                        formatDuration(l.worstSeconds).c_str());
+        }
+    }
+
+    if (deadline <= 0) {
+        return 0;
+    }
+
+    // Cheapest layout meeting the deadline: fewest cores, then fewest nodes, then fewest ranks,
+    // then the fastest engine
+    const Layout* best = nullptr;
+    for (const Layout& l : layouts) {
+        if (l.worstSeconds > deadline) {
+            continue;
+        }
+        if (!best || l.ranks * l.threads < best->ranks * best->threads ||
+            (l.ranks * l.threads == best->ranks * best->threads &&
+             (l.nodes < best->nodes ||
+              (l.nodes == best->nodes &&
+               (l.ranks < best->ranks || (l.ranks == best->ranks && l.keysPerSecond > best->keysPerSecond)))))) {
+            best = &l;
+        }
+    }
+    if (!best) {
+        const Layout* fastest = &layouts[0];
+        for (const Layout& l : layouts) {
+            if (l.worstSeconds < fastest->worstSeconds) {
+                fastest = &l;
+            }
+        }
+        std::cout << "No layout meets the deadline of " << formatDuration(deadline) << "; the fastest ("
+                  << fastest->engine << ", " << fastest->ranks << " ranks x " << fastest->threads
+                  << " threads) needs " << formatDuration(fastest->worstSeconds) << " in the worst case." << std::endl;
+        return 2;
+    }
+    std::cout << "Recommended: ";
+    if (best->mpi) {
+        std::cout << "mpirun -np " << best->ranks << " ";
+    }
+    std::cout << best->engine << " ...";
+    if (best->threaded) {
+        std::cout << " --threads " << best->threads;
+    }
+    std::cout << " (" << best->nodes << " node(s)): expected " << formatDuration(best->expectedSeconds)
+              << ", worst case " << formatDuration(best->worstSeconds) << std::endl;
+    return 0;
+}
@@ -0,0 +1,382 @@
+/**
+ * @file solved_cache.h
+ * @brief Persistent cache of search results, keyed by a hash of the job.
+ *
+ * The same ciphertexts come back: re-submitted tickets, duplicates inside a corpus. The
+ * cache maps the SHA-256 of what decides a search's outcome (engine, key space, the
+ * ciphertext blocks the predicate decrypts, the crib offset and the phrase) to the key
+ * that was found or, for jobs that were not solved, to the key ranges already searched.
+ * Process 0 looks a job up before searching it: a solved job is answered without any
+ * search, and the chunks of a partly searched one are skipped.
+ *
+ * The cache is one append-only text log in the cache directory:
+ *
+ *     S <sha256> <key>            the job was solved with <key>
+ *     C <sha256> <begin> <end>    keys [begin, end) of the job were searched without success
+ *
+ * Records are appended with a single `write` on an `O_APPEND` descriptor under an
+ * exclusive `flock`, so several launches can share the cache. Once the log holds many
+ * more records than jobs it is compacted: the merged entries are written to a temporary
+ * file that is renamed over the log, all under the lock. A writer that waited for the lock
+ * on the replaced log notices the inode change and reopens the new one.
+ *
+ * @date October 2024
+ */
+
+#ifndef SOLVED_CACHE_H
+#define SOLVED_CACHE_H
+
+#include <fcntl.h>
+#include <mpi.h>
+#include <openssl/sha.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "coverage.h"
+#include "job_descriptor.h"
+
+/// Sorted, disjoint key ranges [begin, end).
+typedef std::vector<std::pair<uint64_t, uint64_t>> KeyRanges;
+
+/**
+ * @brief Sorts key ranges and merges the overlapping and adjacent ones.
+ */
+static inline void mergeRanges(KeyRanges& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+    size_t out = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (ranges[i].first >= ranges[i].second) {
+            continue;
+        }
+        if (out > 0 && ranges[i].first <= ranges[out - 1].second) {
+            ranges[out - 1].second = std::max(ranges[out - 1].second, ranges[i].second);
+        } else {
+            ranges[out++] = ranges[i];
+        }
+    }
+    ranges.resize(out);
+}
+
+/**
+ * @brief Checks whether merged ranges contain all of [begin, end).
+ */
+static inline bool rangesContain(const KeyRanges& ranges, uint64_t begin, uint64_t end) {
+    auto after = std::upper_bound(ranges.begin(), ranges.end(), std::make_pair(begin, UINT64_MAX));
+    return after != ranges.begin() && (after - 1)->second >= end;
+}
+
+/**
+ * @brief Returns the key ranges covered by the first `completed[r]` chunks of every rank.
+ */
+static inline KeyRanges completedRanges(const ChunkPlan& plan, const std::vector<uint64_t>& completed) {
+    KeyRanges ranges;
+    uint64_t common = *std::min_element(completed.begin(), completed.end());
+    uint64_t begin, end;
+    if (plan.prior == PRIOR_LOW_FIRST && common > 0) {
+        // The chunks every rank completed form one prefix of the key space
+        ranges.push_back(std::make_pair(0, std::min(common * plan.numRanks * plan.chunkSize, plan.keyspace)));
+    } else {
+        common = 0;
+    }
+    for (int r = 0; r < plan.numRanks; ++r) {
+        if (completed[r] == common) {
+            continue;
+        }
+        if (plan.prior == PRIOR_LOW_FIRST) {
+            for (uint64_t i = common; i < completed[r]; ++i) {
+                plan.chunk(r, i, begin, end);
+                ranges.push_back(std::make_pair(begin, end));
+            }
+        } else {
+            uint64_t unused;
+            plan.chunk(r, 0, begin, unused);
+            plan.chunk(r, completed[r] - 1, unused, end);
+            ranges.push_back(std::make_pair(begin, end));
+        }
+    }
+    mergeRanges(ranges);
+    return ranges;
+}
+
+/**
+ * @brief Returns the hex SHA-256 identifying the outcome of a job's search.
+ *
+ * @param job The job.
+ * @param checks The further pairs a key of the job must pass, if any. A job without them
+ * keeps the digest it always had.
+ */
+static inline std::string jobDigest(const JobDescriptor& job,
+                                    const std::vector<JobDescriptor>& checks = std::vector<JobDescriptor>()) {
+    std::vector<char> bytes;
+    auto put = [&bytes](const void* p, size_t n) {
+        bytes.insert(bytes.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+    };
+    for (size_t i = 0; i <= checks.size(); ++i) {
+        const JobDescriptor& pair = i == 0 ? job : checks[i - 1];
+        uint32_t cipherBytes = pair.ciphertext.size();
+        uint32_t phraseBytes = pair.phrase.size();
+        put(&pair.engine, sizeof(pair.engine));
+        put(&pair.keyspace, sizeof(pair.keyspace));
+        put(&pair.cribOffset, sizeof(pair.cribOffset));
+        put(&cipherBytes, sizeof(cipherBytes));
+        put(&phraseBytes, sizeof(phraseBytes));
+        put(pair.ciphertext.data(), cipherBytes);
+        put(pair.phrase.data(), phraseBytes);
+        if (pair.engine == ENGINE_DES_CBC) {
+            put(pair.chain, sizeof(pair.chain));  // The window decrypts differently under another chain block
+        }
+        if (pair.engine == ENGINE_RC4_40) {
+            put(&pair.windowOffset, sizeof(pair.windowOffset));  // ... or at another keystream offset
+        }
+    }
+
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size(), digest);
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char b : digest) {
+        hex += digits[b >> 4];
+        hex += digits[b & 15];
+    }
+    return hex;
+}
+
+/**
+ * @brief What the cache knows about one job.
+ */
+struct CacheEntry {
+    bool solved = false;  ///< The key is known.
+    uint64_t key = 0;     ///< The key, when solved.
+    KeyRanges covered;    ///< Key ranges searched without success, when not solved.
+
+    /// Whether the whole key space was searched without finding the key.
+    bool exhausted(uint64_t keyspace) const { return !solved && rangesContain(covered, 0, keyspace); }
+};
+
+/**
+ * @brief The on-disk cache, used by process 0 only.
+ */
+class SolvedCache {
+public:
+    SolvedCache() : records(0) {}
+
+    /**
+     * @brief Opens (creating it if needed) the cache in `dir` and loads its entries.
+     *
+     * @param error Set to a description of the problem on failure.
+     * @return true If the cache can be used.
+     */
+    bool open(const std::string& dir, std::string& error) {
+        mkdir(dir.c_str(), 0777);
+        logPath = dir + "/solved.log";
+        int fd = ::open(logPath.c_str(), O_RDONLY | O_CREAT, 0666);
+        if (fd < 0) {
+            error = "Cannot open cache " + logPath;
+            logPath.clear();
+            return false;
+        }
+        flock(fd, LOCK_SH);
+        load(fd);
+        flock(fd, LOCK_UN);
+        close(fd);
+        if (records > 2 * entries.size() + 1024) {
+            compact();
+        }
+        return true;
+    }
+
+    /// Whether open() succeeded.
+    bool isOpen() const { return !logPath.empty(); }
+
+    /**
+     * @brief Returns what the cache knows about the job with the given digest.
+     */
+    CacheEntry lookup(const std::string& digest) const {
+        auto it = entries.find(digest);
+        return it == entries.end() ? CacheEntry() : it->second;
+    }
+
+    /**
+     * @brief Records the key of a solved job.
+     */
+    bool recordSolved(const std::string& digest, uint64_t key) {
+        return append("S " + digest + " " + std::to_string(key) + "\n");
+    }
+
+    /**
+     * @brief Records key ranges searched without finding the key of a job.
+     */
+    bool recordCovered(const std::string& digest, const KeyRanges& ranges) {
+        std::string lines;
+        for (const auto& range : ranges) {
+            lines += "C " + digest + " " + std::to_string(range.first) + " " + std::to_string(range.second) + "\n";
+        }
+        return lines.empty() || append(lines);
+    }
+
+private:
+    /// Applies one log record to the in-memory entries; ranges are merged by the caller.
+    CacheEntry* apply(const std::string& line) {
+        std::istringstream fields(line);
+        std::string type, digest;
+        uint64_t a = 0, b = 0;
+        if (!(fields >> type >> digest >> a)) {
+            return nullptr;
+        }
+        CacheEntry& entry = entries[digest];
+        if (type == "S") {
+            entry.solved = true;
+            entry.key = a;
+            entry.covered.clear();
+        } else if (type == "C" && fields >> b && !entry.solved) {
+            entry.covered.push_back(std::make_pair(a, b));
+        }
+        ++records;
+        return &entry;
+    }
+
+    /// Reads every record of the log open on `fd`.
+    void load(int fd) {
+        entries.clear();
+        records = 0;
+        std::string text, line;
+        char buffer[65536];
+        ssize_t n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+            text.append(buffer, n);
+        }
+        std::istringstream lines(text);
+        while (std::getline(lines, line)) {
+            apply(line);
+        }
+        for (auto& it : entries) {
+            mergeRanges(it.second.covered);
+        }
+    }
+
+    /**
+     * @brief Opens the current log and locks it exclusively.
+     *
+     * @return The descriptor, or -1; retries when the log was replaced by a compaction.
+     */
+    int lockLog() const {
+        while (true) {
+            int fd = ::open(logPath.c_str(), O_RDWR | O_APPEND | O_CREAT, 0666);
+            if (fd < 0) {
+                return -1;
+            }
+            flock(fd, LOCK_EX);
+            struct stat held, current;
+            if (fstat(fd, &held) == 0 && stat(logPath.c_str(), &current) == 0 && held.st_ino == current.st_ino) {
+                return fd;
+            }
+            close(fd);
+        }
+    }
+
+    /// Appends records to the log and to the in-memory entries.
+    bool append(const std::string& lines) {
+        int fd = lockLog();
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = write(fd, lines.data(), lines.size()) == static_cast<ssize_t>(lines.size());
+        close(fd);
+        std::istringstream in(lines);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (CacheEntry* entry = apply(line)) {
+                mergeRanges(entry->covered);
+            }
+        }
+        return ok;
+    }
+
+    /// Rewrites the log with one record per solved job and per merged range.
+    void compact() {
+        int fd = lockLog();
+        if (fd < 0) {
+            return;
+        }
+        lseek(fd, 0, SEEK_SET);
+        load(fd);  // Other launches may have appended since open()
+        std::string tmpPath = logPath + "." + std::to_string(getpid()) + ".tmp";
+        FILE* out = fopen(tmpPath.c_str(), "w");
+        if (out) {
+            size_t written = 0;
+            for (const auto& it : entries) {
+                if (it.second.solved) {
+                    std::fprintf(out, "S %s %llu\n", it.first.c_str(), static_cast<unsigned long long>(it.second.key));
+                    ++written;
+                }
+                for (const auto& range : it.second.covered) {
+                    std::fprintf(out, "C %s %llu %llu\n", it.first.c_str(),
+                                 static_cast<unsigned long long>(range.first),
+                                 static_cast<unsigned long long>(range.second));
+                    ++written;
+                }
+            }
+            if (fclose(out) == 0 && std::rename(tmpPath.c_str(), logPath.c_str()) == 0) {
+                records = written;
+            } else {
+                std::remove(tmpPath.c_str());
+            }
+        }
+        close(fd);
+    }
+
+    std::string logPath;
+    std::map<std::string, CacheEntry> entries;
+    size_t records;  ///< Records in the log, to decide when to compact.
+};
+
+/**
+ * @brief Broadcasts process 0's cache entry for the current job. Collective over `comm`.
+ */
+static inline void shareCacheEntry(MPI_Comm comm, CacheEntry& entry) {
+    uint64_t header[3] = {entry.solved ? 1ULL : 0ULL, entry.key, entry.covered.size()};
+    MPI_Bcast(header, 3, MPI_UINT64_T, 0, comm);
+    entry.solved = header[0] != 0;
+    entry.key = header[1];
+    entry.covered.resize(header[2]);
+    if (header[2] > 0) {
+        MPI_Bcast(entry.covered.data(), 2 * header[2], MPI_UINT64_T, 0, comm);
+    }
+}
+
+/**
+ * @brief Records the outcome of a job's search in the cache (process 0 records; collective).
+ *
+ * @param comm The communicator of the search.
+ * @param cache The cache; not used when it is not open.
+ * @param digest The job's digest.
+ * @param plan Assignment of the chunks to the ranks.
+ * @param chunkIndex Chunks of the calling rank's sequence that are searched (or skipped as cached).
+ * @param found Whether the key was found.
+ * @param key The key, when found.
+ */
+static inline void recordSearch(MPI_Comm comm, SolvedCache& cache, const std::string& digest, const ChunkPlan& plan,
+                                uint64_t chunkIndex, bool found, uint64_t key) {
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<uint64_t> completed = gatherCompleted(comm, plan, chunkIndex);
+    if (processId != 0 || !cache.isOpen()) {
+        return;
+    }
+    bool ok = found ? cache.recordSolved(digest, key) : cache.recordCovered(digest, completedRanges(plan, completed));
+    if (!ok) {
+        std::fprintf(stderr, "Failed to update the solved cache\n");
+    }
+}
+
+#endif  // SOLVED_CACHE_H
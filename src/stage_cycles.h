@@ -0,0 +1,133 @@
+/**
+ * @file stage_cycles.h
+ * @brief Optional per-stage cycle counters for the key-testing hot path.
+ *
+ * The counters are a template policy: `StageCounters<true>` reads the time-stamp counter
+ * at every stage boundary and accumulates the cycles per stage, while `StageCounters<false>`
+ * is empty and every call on it compiles away. `StageTimer` selects the policy from the
+ * `STAGE_CYCLES` macro, so a normal build carries no instrumentation at all:
+ *
+ *     make clean && make STAGE_CYCLES=1
+ *
+ * @date October 2024
+ */
+
+#ifndef STAGE_CYCLES_H
+#define STAGE_CYCLES_H
+
+#include <mpi.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifndef STAGE_CYCLES
+#define STAGE_CYCLES 0  // Set to 1 (or build with make STAGE_CYCLES=1) to count cycles per stage
+#endif
+
+/**
+ * @brief Stages of testing a key.
+ */
+enum Stage {
+    STAGE_KEYGEN,        ///< Turning the key index into key bytes.
+    STAGE_KEY_SCHEDULE,  ///< Parity and key schedule setup.
+    STAGE_ROUNDS,        ///< Cipher rounds.
+    STAGE_PREDICATE,     ///< Checking the decrypted text for the search phrase.
+    STAGE_VERIFY,        ///< Verifying a found key.
+    STAGE_POLL,          ///< Polling other ranks for a found key.
+    NUM_STAGES
+};
+
+static const char* const kStageNames[NUM_STAGES] = {
+    "keygen", "key schedule", "rounds", "predicate", "verify", "poll"
+};
+
+/**
+ * @brief Reads the cycle counter (or nanoseconds where no TSC is available).
+ */
+static inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * @brief Per-thread cycle accumulator; `Enabled == false` compiles to nothing.
+ */
+template <bool Enabled>
+struct StageCounters {
+    uint64_t cycles[NUM_STAGES] = {};
+    uint64_t last = 0;
+
+    /// Starts timing the next stage.
+    inline void begin() { last = readCycles(); }
+
+    /// Charges the cycles since the previous boundary to `stage`.
+    inline void lap(Stage stage) {
+        uint64_t now = readCycles();
+        cycles[stage] += now - last;
+        last = now;
+    }
+
+    /// Adds these counters into `totals`; callers synchronize.
+    inline void mergeInto(uint64_t* totals) const {
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            totals[s] += cycles[s];
+        }
+    }
+};
+
+template <>
+struct StageCounters<false> {
+    inline void begin() {}
+    inline void lap(Stage) {}
+    inline void mergeInto(uint64_t*) const {}
+};
+
+typedef StageCounters<STAGE_CYCLES != 0> StageTimer;
+
+/**
+ * @brief Sums the stage cycles of all ranks and prints the cycles per key on process 0.
+ *
+ * Collective over `comm`; does nothing when the counters are compiled out.
+ *
+ * @param comm The communicator of the search.
+ * @param cycles Cycles per stage accumulated by the calling rank.
+ * @param keysTested Keys tested by the calling rank.
+ */
+static inline void printStageReport(MPI_Comm comm, const uint64_t* cycles, uint64_t keysTested) {
+    if (!STAGE_CYCLES) {
+        return;
+    }
+    int processId;
+    MPI_Comm_rank(comm, &processId);
+
+    uint64_t local[NUM_STAGES + 1], total[NUM_STAGES + 1];
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        local[s] = cycles[s];
+    }
+    local[NUM_STAGES] = keysTested;
+    MPI_Reduce(local, total, NUM_STAGES + 1, MPI_UINT64_T, MPI_SUM, 0, comm);
+
+    if (processId == 0) {
+        uint64_t keys = total[NUM_STAGES] ? total[NUM_STAGES] : 1;
+        uint64_t sum = 0;
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            sum += total[s];
+        }
+        std::printf("Cycles per key by stage (%llu keys):\n", static_cast<unsigned long long>(total[NUM_STAGES]));
+        for (int s = 0; s < NUM_STAGES; ++s) {
+            std::printf("  %-14s %12.1f  (%5.1f%%)\n", kStageNames[s], static_cast<double>(total[s]) / keys,
+                        sum ? 100.0 * total[s] / sum : 0.0);
+        }
+        std::fflush(stdout);
+    }
+}
+
+#endif  // STAGE_CYCLES_H
@@ -0,0 +1,350 @@
+/**
+ * @file trace.h
+ * @brief Per-thread timeline recorder that exports a Chrome trace of the key search.
+ *
+ * Each thread appends timestamped events (lease, chunk, poll, idle, verify, barrier)
+ * to its own ring buffer, so recording never takes a lock on the hot path. A buffer grows
+ * with its events up to a fixed capacity, so short-lived threads cost little memory.
+ * At exit every rank sends its events to process 0, which shifts them by the measured
+ * clock offset of that rank and writes a single JSON file that can be opened with
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Recording is disabled unless `trace::enable()` is called, in which case the cost of
+ * a disabled `trace::Scope` is a single relaxed atomic load.
+ *
+ * @date October 2024
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <mpi.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trace {
+
+/**
+ * @brief Kinds of events recorded on the timeline.
+ */
+enum EventKind : uint32_t {
+    LEASE,    ///< A range of keys was handed to this rank.
+    CHUNK,    ///< A thread searched one chunk of keys.
+    POLL,     ///< The rank polled for a found-key message.
+    IDLE,     ///< The rank waited for work or for other ranks.
+    VERIFY,   ///< A candidate key was verified.
+    BARRIER,  ///< A thread waited at the end-of-chunk barrier.
+    NUM_EVENT_KINDS
+};
+
+static const char* const kEventNames[NUM_EVENT_KINDS] = {
+    "lease", "chunk", "poll", "idle", "verify", "barrier"
+};
+
+/// Duration value used for instant events.
+static const uint64_t kInstant = ~0ULL;
+
+/// Number of events kept per thread; older events are overwritten.
+static const size_t kRingCapacity = 1 << 16;
+
+/**
+ * @brief A single timeline event, laid out so it can be sent as raw bytes.
+ */
+struct Event {
+    uint64_t startNs;  ///< Start time on the local steady clock.
+    uint64_t durNs;    ///< Duration, or kInstant for instant events.
+    uint64_t arg;      ///< Event argument (e.g. first key of the chunk).
+    uint32_t kind;     ///< EventKind.
+    uint32_t tid;      ///< Recorder-assigned thread index.
+};
+
+/**
+ * @brief Returns the current time of the steady clock in nanoseconds.
+ */
+static inline uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Process-wide registry of per-thread ring buffers.
+ */
+class Recorder {
+public:
+    static Recorder& instance() {
+        static Recorder recorder;
+        return recorder;
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+
+    void enable() { on.store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief Files the calling thread's events under timeline lane `lane`.
+     */
+    void setLane(uint32_t lane) { localRing().tid = lane; }
+
+    /**
+     * @brief Appends an event to the calling thread's ring buffer.
+     */
+    void record(EventKind kind, uint64_t startNs, uint64_t durNs, uint64_t arg) {
+        Ring& ring = localRing();
+        if (ring.events.size() < kRingCapacity) {
+            ring.events.emplace_back();
+        }
+        Event& e = ring.events[ring.head % kRingCapacity];
+        e.startNs = startNs;
+        e.durNs = durNs;
+        e.arg = arg;
+        e.kind = kind;
+        e.tid = ring.tid;
+        ++ring.head;
+    }
+
+    /**
+     * @brief Collects the surviving events of every thread, oldest first per thread.
+     *
+     * Must only be called once all recording threads are quiescent.
+     */
+    std::vector<Event> collect() {
+        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<Event> all;
+        for (const auto& ring : rings) {
+            uint64_t count = std::min<uint64_t>(ring->head, kRingCapacity);
+            for (uint64_t i = ring->head - count; i < ring->head; ++i) {
+                all.push_back(ring->events[i % kRingCapacity]);
+            }
+        }
+        return all;
+    }
+
+private:
+    struct Ring {
+        std::vector<Event> events;
+        uint64_t head;
+        uint32_t tid;
+    };
+
+    Recorder() : on(false) {}
+
+    Ring& localRing() {
+        static thread_local Ring* ring = nullptr;
+        if (ring == nullptr) {
+            std::lock_guard<std::mutex> lock(mtx);
+            rings.emplace_back(new Ring());
+            ring = rings.back().get();
+            ring->head = 0;
+            ring->tid = rings.size() - 1;
+        }
+        return *ring;
+    }
+
+    std::atomic<bool> on;
+    std::mutex mtx;
+    std::vector<std::unique_ptr<Ring>> rings;
+};
+
+/**
+ * @brief Turns on event recording for this process.
+ */
+static inline void enable() {
+    Recorder::instance().enable();
+}
+
+/**
+ * @brief Files the calling thread's events under timeline lane `lane` if tracing is enabled.
+ *
+ * By default every thread gets its own lane. Threads started anew for every piece of work
+ * (e.g. the pipeline stages of mpi_bruteforce_v3) use this to share one lane per role.
+ */
+static inline void setLane(uint32_t lane) {
+    Recorder& r = Recorder::instance();
+    if (r.enabled()) {
+        r.setLane(lane);
+    }
+}
+
+/**
+ * @brief Records an instant event if tracing is enabled.
+ */
+static inline void instant(EventKind kind, uint64_t arg = 0) {
+    Recorder& r = Recorder::instance();
+    if (r.enabled()) {
+        r.record(kind, now(), kInstant, arg);
+    }
+}
+
+/**
+ * @brief RAII helper that records a span from construction to destruction.
+ */
+class Scope {
+public:
+    explicit Scope(EventKind k, uint64_t a = 0) : kind(k), arg(a), start(0) {
+        if (Recorder::instance().enabled()) {
+            start = now();
+        }
+    }
+
+    ~Scope() {
+        if (start != 0) {
+            Recorder::instance().record(kind, start, now() - start, arg);
+        }
+    }
+
+private:
+    EventKind kind;
+    uint64_t arg;
+    uint64_t start;
+};
+
+/**
+ * @brief Estimates the offset of every rank's steady clock relative to process 0.
+ *
+ * Process 0 exchanges a few ping-pong messages with each rank and keeps the sample
+ * with the lowest round-trip time (Cristian's algorithm). Collective over `comm`.
+ *
+ * @param comm Communicator reserved for the exchange.
+ * @return On process 0, the offset (ns) to add to each rank's timestamps; empty elsewhere.
+ */
+static inline std::vector<int64_t> estimateClockOffsets(MPI_Comm comm) {
+    const int rounds = 8;
+    int numProcesses, processId;
+    MPI_Comm_size(comm, &numProcesses);
+    MPI_Comm_rank(comm, &processId);
+
+    std::vector<int64_t> offsets;
+    if (processId == 0) {
+        offsets.assign(numProcesses, 0);
+        for (int r = 1; r < numProcesses; ++r) {
+            uint64_t bestRtt = ~0ULL;
+            for (int i = 0; i < rounds; ++i) {
+                uint64_t remote;
+                uint64_t t0 = now();
+                MPI_Send(&t0, 1, MPI_UINT64_T, r, 0, comm);
+                MPI_Recv(&remote, 1, MPI_UINT64_T, r, 0, comm, MPI_STATUS_IGNORE);
+                uint64_t t1 = now();
+                if (t1 - t0 < bestRtt) {
+                    bestRtt = t1 - t0;
+                    offsets[r] = static_cast<int64_t>(t0 + (t1 - t0) / 2) - static_cast<int64_t>(remote);
+                }
+            }
+        }
+    } else {
+        for (int i = 0; i < rounds; ++i) {
+            uint64_t ping;
+            MPI_Recv(&ping, 1, MPI_UINT64_T, 0, 0, comm, MPI_STATUS_IGNORE);
+            uint64_t t = now();
+            MPI_Send(&t, 1, MPI_UINT64_T, 0, 0, comm);
+        }
+    }
+    return offsets;
+}
+
+/**
+ * @brief Returns the offset (ns) that maps this rank's steady clock onto process 0's clock.
+ *
+ * Collective over `comm`; the exchange runs on a private duplicate of it.
+ */
+static inline int64_t localClockOffset(MPI_Comm comm) {
+    MPI_Comm syncComm;
+    MPI_Comm_dup(comm, &syncComm);
+    std::vector<int64_t> offsets = estimateClockOffsets(syncComm);
+    int64_t offset = 0;
+    MPI_Scatter(offsets.data(), 1, MPI_INT64_T, &offset, 1, MPI_INT64_T, 0, syncComm);
+    MPI_Comm_free(&syncComm);
+    return offset;
+}
+
+/**
+ * @brief Gathers every rank's events on process 0 and writes them as Chrome trace JSON.
+ *
+ * Collective over `comm`; every rank must call it, whether or not tracing is enabled.
+ *
+ * @param comm The communicator of the search.
+ * @param path Output file, written by process 0 only.
+ */
+static inline void writeChromeTrace(MPI_Comm comm, const std::string& path) {
+    MPI_Comm traceComm;
+    MPI_Comm_dup(comm, &traceComm);
+
+    int numProcesses, processId;
+    MPI_Comm_size(traceComm, &numProcesses);
+    MPI_Comm_rank(traceComm, &processId);
+
+    std::vector<int64_t> offsets = estimateClockOffsets(traceComm);
+
+    std::vector<Event> local = Recorder::instance().collect();
+    int localBytes = local.size() * sizeof(Event);
+    std::vector<int> counts(numProcesses), displs(numProcesses);
+    MPI_Gather(&localBytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, traceComm);
+
+    std::vector<Event> all;
+    if (processId == 0) {
+        int total = 0;
+        for (int r = 0; r < numProcesses; ++r) {
+            displs[r] = total;
+            total += counts[r];
+        }
+        all.resize(total / sizeof(Event));
+    }
+    MPI_Gatherv(local.data(), localBytes, MPI_BYTE, all.data(), counts.data(), displs.data(),
+                MPI_BYTE, 0, traceComm);
+    MPI_Comm_free(&traceComm);
+
+    if (processId != 0) {
+        return;
+    }
+
+    // Shift every event onto process 0's clock and find the common origin
+    std::vector<int> owner(all.size());
+    int64_t origin = INT64_MAX;
+    for (int r = 0, i = 0; r < numProcesses; ++r) {
+        for (size_t n = 0; n < counts[r] / sizeof(Event); ++n, ++i) {
+            owner[i] = r;
+            int64_t ts = static_cast<int64_t>(all[i].startNs) + offsets[r];
+            all[i].startNs = ts;
+            origin = std::min(origin, ts);
+        }
+    }
+
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "Failed to open trace file %s\n", path.c_str());
+        return;
+    }
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    // A separator precedes every record but the first: no trailing comma even without events
+    const char* separator = "";
+    for (int r = 0; r < numProcesses; ++r) {
+        std::fprintf(out, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}",
+                     separator, r, r);
+        separator = ",\n";
+    }
+    for (size_t i = 0; i < all.size(); ++i) {
+        const Event& e = all[i];
+        std::fprintf(out, "%s", separator);
+        separator = ",\n";
+        double ts = (static_cast<int64_t>(e.startNs) - origin) / 1000.0;
+        if (e.durNs == kInstant) {
+            std::fprintf(out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+                         kEventNames[e.kind], ts, owner[i], e.tid, static_cast<unsigned long long>(e.arg));
+        } else {
+            std::fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"arg\":%llu}}",
+                         kEventNames[e.kind], ts, e.durNs / 1000.0, owner[i], e.tid,
+                         static_cast<unsigned long long>(e.arg));
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+    fclose(out);
+}
+
+}  // namespace trace
+
+#endif  // TRACE_H